@@ -22,6 +22,56 @@
 #include "state_machine.h"
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
+
+static void state_machine_rebuild_reachability(state_machine_t *state_machine) {
+  state_machine_state_mask_t *reachable = state_machine->reachable_states;
+
+  // Every state reaches itself and its direct successors
+  for (int state = 0; state < STATE_MACHINE_STATE_MAX; state++) {
+    reachable[state] = (state_machine_state_mask_t)1 << state;
+    for (int event = 0; event < MAX_EVENTS_PER_STATE; event++) {
+      if (state_machine->state_transitions[state][event].init) {
+        reachable[state] |= (state_machine_state_mask_t)1 << state_machine->state_transitions[state][event].next_state;
+      }
+    }
+  }
+
+  // Warshall's transitive closure, one word per row
+  for (int via = 0; via < STATE_MACHINE_STATE_MAX; via++) {
+    for (int state = 0; state < STATE_MACHINE_STATE_MAX; state++) {
+      if (reachable[state] & ((state_machine_state_mask_t)1 << via)) {
+        reachable[state] |= reachable[via];
+      }
+    }
+  }
+}
+
+static uint8_t state_machine_kind(int present, int legacy) {
+  if (!present) {
+    return 0;
+  }
+  return legacy ? STATE_MACHINE_KIND_LEGACY : STATE_MACHINE_KIND_ACTION;
+}
+
+static void state_machine_rebuild_kinds(state_machine_t *state_machine) {
+  uint8_t kinds = 0;
+  for (int state = 0; state < STATE_MACHINE_STATE_MAX; state++) {
+    const state_table_entry_t *entry = &state_machine->state_table[state];
+    kinds |= state_machine_kind(entry->state_on_enter.action != NULL, entry->flags & STATE_MACHINE_LEGACY_ENTER);
+    kinds |= state_machine_kind(entry->state_on_exit.action != NULL, entry->flags & STATE_MACHINE_LEGACY_EXIT);
+    for (int event = 0; event < MAX_EVENTS_PER_STATE; event++) {
+      const state_machine_transition_t *transition = &state_machine->state_transitions[state][event];
+      if (transition->init) {
+        kinds |= state_machine_kind(transition->on_transition.action != NULL,
+                                    transition->flags & STATE_MACHINE_LEGACY_ACTION);
+        kinds |= state_machine_kind(transition->guard.action_guard != NULL,
+                                    transition->flags & STATE_MACHINE_LEGACY_GUARD);
+      }
+    }
+  }
+  state_machine->handler_kinds = kinds;
+}
 
 state_machine_t *state_machine_create(state_id_t initial_state) {
   // Zeroing is required, assumed zeroed initial state
@@ -29,68 +79,194 @@ state_machine_t *state_machine_create(state_id_t initial_state) {
   assert(state_machine != NULL);
   state_machine->initial_state = initial_state;
   state_machine->current_state = initial_state;
+  state_machine_rebuild_reachability(state_machine);
   return state_machine;
 }
 
 void state_machine_destroy(state_machine_t *state_machine) {
   assert(state_machine != NULL);
+  // From a copy, an observer may detach itself when told
+  state_machine_observer_entry_t observers[STATE_MACHINE_OBSERVERS_MAX];
+  uint32_t count = state_machine->observer_count;
+  memcpy(observers, state_machine->observers, sizeof(observers));
+  for (uint32_t i = 0; i < count; i++) {
+    observers[i].observer(state_machine, STATE_MACHINE_NOTIFY_DESTROY, observers[i].context);
+  }
   free(state_machine);
 }
 
+#if defined(__GNUC__)
+#define STATE_MACHINE_ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define STATE_MACHINE_ALWAYS_INLINE inline
+#endif
+
+// kind is a constant at every use, so a single-kind path compiles to a direct call
+// without the flag test or, for legacy handlers, the context load
+#define STATE_MACHINE_IS_LEGACY(kind, legacy) \
+  ((kind) == STATE_MACHINE_KIND_LEGACY || ((kind) != STATE_MACHINE_KIND_ACTION && (legacy)))
+
+// The null check comes first, a slot without a handler never looks at its flags
+#define STATE_MACHINE_CALL(slot, legacy, context, event, kind) \
+  do { \
+    if ((slot).action) { \
+      if (STATE_MACHINE_IS_LEGACY(kind, legacy)) { \
+        (slot).handler(*(event)); \
+      } else { \
+        (slot).action((event), (context)); \
+      } \
+    } \
+  } while (0)
+
+static STATE_MACHINE_ALWAYS_INLINE int state_machine_fire(
+    const state_machine_t *definition,
+    state_id_t *current_state,
+    const state_machine_transition_t *transition,
+    const event_t *event,
+    const unsigned kind) {
+  const state_table_entry_t *from = &definition->state_table[*current_state];
+  const state_table_entry_t *to = &definition->state_table[transition->next_state];
+
+  // Check guard condition if it exists
+  if (transition->guard.action_guard) {
+    if (STATE_MACHINE_IS_LEGACY(kind, transition->flags & STATE_MACHINE_LEGACY_GUARD)) {
+      if (!transition->guard.guard(*event)) {
+        return 0;  // Skip transition if guard condition is not met
+      }
+    } else if (!transition->guard.action_guard(event, transition->guard_context)) {
+      return 0;
+    }
+  }
+
+  const state_id_t next_state = transition->next_state;
+  const state_machine_handler_t on_transition = transition->on_transition;
+  STATE_MACHINE_CALL(from->state_on_exit, from->flags & STATE_MACHINE_LEGACY_EXIT, from->on_exit_context, event, kind);
+  STATE_MACHINE_CALL(on_transition, transition->flags & STATE_MACHINE_LEGACY_ACTION, transition->action_context, event, kind);
+  *current_state = next_state;
+  STATE_MACHINE_CALL(to->state_on_enter, to->flags & STATE_MACHINE_LEGACY_ENTER, to->on_enter_context, event, kind);
+  return 1;
+}
+
+// Returns 1 if the event caused a transition, current_state may live outside definition
+static STATE_MACHINE_ALWAYS_INLINE int state_machine_step(const state_machine_t *definition, state_id_t *current_state, const event_t *event) {
+  // Transitions are stored by event id, the accepted mask replaces a scan
+  if (event->event_id >= MAX_EVENTS_PER_STATE ||
+      !((definition->accepted_events[*current_state] >> event->event_id) & 1)) {
+    return 0;
+  }
+  const state_machine_transition_t *transition = &definition->state_transitions[*current_state][event->event_id];
+
+  switch (definition->handler_kinds) {
+    case 0:
+      *current_state = transition->next_state;
+      return 1;
+    case STATE_MACHINE_KIND_LEGACY:
+      return state_machine_fire(definition, current_state, transition, event, STATE_MACHINE_KIND_LEGACY);
+    case STATE_MACHINE_KIND_ACTION:
+      return state_machine_fire(definition, current_state, transition, event, STATE_MACHINE_KIND_ACTION);
+    default:
+      return state_machine_fire(definition, current_state, transition, event,
+                                STATE_MACHINE_KIND_LEGACY | STATE_MACHINE_KIND_ACTION);
+  }
+}
+
+// Bring the optional observers of an instance up to date after an event
+static inline void state_machine_publish(state_machine_t *state_machine, int transitioned) {
+  int notification = transitioned ? STATE_MACHINE_NOTIFY_TRANSITION : STATE_MACHINE_NOTIFY_EVENT;
+  for (uint32_t i = 0; i < state_machine->observer_count; i++) {
+    state_machine->observers[i].observer(state_machine, notification, state_machine->observers[i].context);
+  }
+}
+
 void state_machine_event(state_machine_t *state_machine, event_t event) {
   assert(state_machine != NULL);
+  int transitioned = state_machine_step(state_machine, &state_machine->current_state, &event);
+  state_machine_publish(state_machine, transitioned);
+}
 
-  // Check if there is a transition for the event
-  state_machine_transition_t *state_transitions = state_machine->state_transitions[state_machine->current_state];
-  for (int i = 0; i < MAX_EVENTS_PER_STATE; i++) {
-    if (state_transitions[i].init && state_transitions[i].event_id == event.event_id) {
+void state_machine_dispatch(state_machine_t *state_machine, const event_t *event) {
+  assert(state_machine != NULL);
+  assert(event != NULL);
+  int transitioned = state_machine_step(state_machine, &state_machine->current_state, event);
+  state_machine_publish(state_machine, transitioned);
+}
 
-      // Check guard condition if it exists
-      if (state_transitions[i].guard && !state_transitions[i].guard(event)) {
-        continue;  // Skip transition if guard condition is not met
-      }
+int state_machine_dispatch_state(const state_machine_t *definition, state_id_t *current_state, const event_t *event) {
+  assert(definition != NULL);
+  assert(current_state != NULL && *current_state < STATE_MACHINE_STATE_MAX);
+  assert(event != NULL);
+  return state_machine_step(definition, current_state, event);
+}
 
-      state_table_entry_t *current_state = &state_machine->state_table[state_machine->current_state];
+void state_machine_set_context(state_machine_t *state_machine, void *context) {
+  assert(state_machine != NULL);
+  state_machine->context = context;
 
-      // Call the on exit function if it exists
-      if (current_state->state_on_exit) {
-        current_state->state_on_exit(event);
-      }
-      
-      if (state_transitions[i].on_transition) {
-        state_transitions[i].on_transition(event);
+  // Handlers keep a resolved copy so dispatch never checks whether they are bound
+  for (int state = 0; state < STATE_MACHINE_STATE_MAX; state++) {
+    state_table_entry_t *entry = &state_machine->state_table[state];
+    if (!(entry->flags & STATE_MACHINE_BOUND_ENTER)) {
+      entry->on_enter_context = context;
+    }
+    if (!(entry->flags & STATE_MACHINE_BOUND_EXIT)) {
+      entry->on_exit_context = context;
+    }
+    for (int event = 0; event < MAX_EVENTS_PER_STATE; event++) {
+      state_machine_transition_t *transition = &state_machine->state_transitions[state][event];
+      if (!(transition->flags & STATE_MACHINE_BOUND_ACTION)) {
+        transition->action_context = context;
       }
-      state_machine->current_state = state_transitions[i].next_state;
-      current_state = &state_machine->state_table[state_machine->current_state];
-
-      // Call the on enter function if it exists
-      if (current_state->state_on_enter) {
-        current_state->state_on_enter(event);
+      if (!(transition->flags & STATE_MACHINE_BOUND_GUARD)) {
+        transition->guard_context = context;
       }
-
-      break;
     }
   }
 }
 
-void state_machine_add_transition_with_guard(
+static void state_machine_set_transition(
     state_machine_t *state_machine,
     state_id_t state_a,
     state_id_t state_b,
     event_id_t event_id,
-    state_machine_event_handler_t on_transition,
-    state_machine_guard_t guard) {
+    state_machine_handler_t on_transition,
+    void *action_context,
+    state_machine_guard_slot_t guard,
+    void *guard_context,
+    uint8_t flags) {
   assert(state_machine != NULL);
   assert(state_a < STATE_MACHINE_STATE_MAX);
   assert(state_b < STATE_MACHINE_STATE_MAX);
   assert(event_id < MAX_EVENTS_PER_STATE);
-  
-  state_machine->state_transitions[state_a][event_id].init = 1;
-  state_machine->state_transitions[state_a][event_id].current_state = state_a;
-  state_machine->state_transitions[state_a][event_id].next_state = state_b;
-  state_machine->state_transitions[state_a][event_id].event_id = event_id;
-  state_machine->state_transitions[state_a][event_id].guard = guard;
-  state_machine->state_transitions[state_a][event_id].on_transition = on_transition;
+
+  state_machine_transition_t *transition = &state_machine->state_transitions[state_a][event_id];
+  transition->init = 1;
+  transition->flags = flags;
+  transition->current_state = state_a;
+  transition->next_state = state_b;
+  transition->event_id = event_id;
+  transition->on_transition = on_transition;
+  transition->guard = guard;
+  transition->action_context = flags & STATE_MACHINE_BOUND_ACTION ? action_context : state_machine->context;
+  transition->guard_context = flags & STATE_MACHINE_BOUND_GUARD ? guard_context : state_machine->context;
+
+  state_machine->accepted_events[state_a] |= (state_machine_event_mask_t)1 << event_id;
+  state_machine_rebuild_reachability(state_machine);
+  state_machine_rebuild_kinds(state_machine);
+}
+
+void state_machine_add_transition_with_guard(
+    state_machine_t *state_machine,
+    state_id_t state_a,
+    state_id_t state_b,
+    event_id_t event_id,
+    state_machine_event_handler_t on_transition,
+    state_machine_guard_t guard) {
+  state_machine_handler_t handler;
+  state_machine_guard_slot_t guard_slot;
+  handler.handler = on_transition;
+  guard_slot.guard = guard;
+  state_machine_set_transition(state_machine, state_a, state_b, event_id, handler, NULL, guard_slot, NULL,
+                               STATE_MACHINE_LEGACY_ACTION | STATE_MACHINE_LEGACY_GUARD);
 }
 
 void state_machine_add_transition(
@@ -102,14 +278,172 @@ void state_machine_add_transition(
   state_machine_add_transition_with_guard(state_machine, state_a, state_b, event_id, on_transition, NULL);
 }
 
-void state_machine_assign_on_enter_handler(state_machine_t *state_machine, state_id_t state, state_machine_event_handler_t on_enter) {
+void state_machine_add_transition_action(
+    state_machine_t *state_machine,
+    state_id_t state_a,
+    state_id_t state_b,
+    event_id_t event_id,
+    state_machine_action_t on_transition,
+    state_machine_action_guard_t guard) {
+  state_machine_handler_t handler;
+  state_machine_guard_slot_t guard_slot;
+  handler.action = on_transition;
+  guard_slot.action_guard = guard;
+  state_machine_set_transition(state_machine, state_a, state_b, event_id, handler, NULL, guard_slot, NULL, 0);
+}
+
+void state_machine_add_transition_action_with_context(
+    state_machine_t *state_machine,
+    state_id_t state_a,
+    state_id_t state_b,
+    event_id_t event_id,
+    state_machine_action_t on_transition,
+    void *transition_context,
+    state_machine_action_guard_t guard,
+    void *guard_context) {
+  state_machine_handler_t handler;
+  state_machine_guard_slot_t guard_slot;
+  handler.action = on_transition;
+  guard_slot.action_guard = guard;
+  state_machine_set_transition(state_machine, state_a, state_b, event_id, handler, transition_context,
+                               guard_slot, guard_context, STATE_MACHINE_BOUND_ACTION | STATE_MACHINE_BOUND_GUARD);
+}
+
+// Replaces the enter handler of state, flags says which signature and whether context is its own
+static void state_machine_set_on_enter(
+    state_machine_t *state_machine,
+    state_id_t state,
+    state_machine_handler_t on_enter,
+    void *context,
+    uint8_t flags) {
   assert(state_machine != NULL);
   assert(state < STATE_MACHINE_STATE_MAX);
-  state_machine->state_table[state].state_on_enter = on_enter;
+  state_table_entry_t *entry = &state_machine->state_table[state];
+  entry->state_on_enter = on_enter;
+  entry->on_enter_context = flags & STATE_MACHINE_BOUND_ENTER ? context : state_machine->context;
+  entry->flags = (uint8_t)((entry->flags & ~(STATE_MACHINE_BOUND_ENTER | STATE_MACHINE_LEGACY_ENTER)) | flags);
+  state_machine_rebuild_kinds(state_machine);
+}
+
+static void state_machine_set_on_exit(
+    state_machine_t *state_machine,
+    state_id_t state,
+    state_machine_handler_t on_exit,
+    void *context,
+    uint8_t flags) {
+  assert(state_machine != NULL);
+  assert(state < STATE_MACHINE_STATE_MAX);
+  state_table_entry_t *entry = &state_machine->state_table[state];
+  entry->state_on_exit = on_exit;
+  entry->on_exit_context = flags & STATE_MACHINE_BOUND_EXIT ? context : state_machine->context;
+  entry->flags = (uint8_t)((entry->flags & ~(STATE_MACHINE_BOUND_EXIT | STATE_MACHINE_LEGACY_EXIT)) | flags);
+  state_machine_rebuild_kinds(state_machine);
+}
+
+void state_machine_assign_on_enter_handler(state_machine_t *state_machine, state_id_t state, state_machine_event_handler_t on_enter) {
+  state_machine_handler_t handler;
+  handler.handler = on_enter;
+  state_machine_set_on_enter(state_machine, state, handler, NULL, STATE_MACHINE_LEGACY_ENTER);
 }
 
 void state_machine_assign_on_exit_handler(state_machine_t *state_machine, state_id_t state, state_machine_event_handler_t on_exit) {
+  state_machine_handler_t handler;
+  handler.handler = on_exit;
+  state_machine_set_on_exit(state_machine, state, handler, NULL, STATE_MACHINE_LEGACY_EXIT);
+}
+
+void state_machine_assign_on_enter_action(state_machine_t *state_machine, state_id_t state, state_machine_action_t on_enter) {
+  state_machine_handler_t handler;
+  handler.action = on_enter;
+  state_machine_set_on_enter(state_machine, state, handler, NULL, 0);
+}
+
+void state_machine_assign_on_exit_action(state_machine_t *state_machine, state_id_t state, state_machine_action_t on_exit) {
+  state_machine_handler_t handler;
+  handler.action = on_exit;
+  state_machine_set_on_exit(state_machine, state, handler, NULL, 0);
+}
+
+void state_machine_assign_on_enter_action_with_context(
+    state_machine_t *state_machine, state_id_t state, state_machine_action_t on_enter, void *context) {
+  state_machine_handler_t handler;
+  handler.action = on_enter;
+  state_machine_set_on_enter(state_machine, state, handler, context, STATE_MACHINE_BOUND_ENTER);
+}
+
+void state_machine_assign_on_exit_action_with_context(
+    state_machine_t *state_machine, state_id_t state, state_machine_action_t on_exit, void *context) {
+  state_machine_handler_t handler;
+  handler.action = on_exit;
+  state_machine_set_on_exit(state_machine, state, handler, context, STATE_MACHINE_BOUND_EXIT);
+}
+
+int state_machine_add_observer(state_machine_t *state_machine, state_machine_observer_t observer, void *context) {
+  assert(state_machine != NULL);
+  assert(observer != NULL);
+  if (state_machine->observer_count == STATE_MACHINE_OBSERVERS_MAX) {
+    return -1;
+  }
+  state_machine->observers[state_machine->observer_count].observer = observer;
+  state_machine->observers[state_machine->observer_count].context = context;
+  state_machine->observer_count++;
+  return 0;
+}
+
+int state_machine_remove_observer(state_machine_t *state_machine, state_machine_observer_t observer, void *context) {
+  assert(state_machine != NULL);
+  for (uint32_t i = 0; i < state_machine->observer_count; i++) {
+    if (state_machine->observers[i].observer == observer && state_machine->observers[i].context == context) {
+      // Keep the remaining observers in order
+      memmove(&state_machine->observers[i], &state_machine->observers[i + 1],
+              (state_machine->observer_count - i - 1) * sizeof(state_machine_observer_entry_t));
+      state_machine->observer_count--;
+      return 0;
+    }
+  }
+  return -1;
+}
+
+void *state_machine_observer_context(const state_machine_t *state_machine, state_machine_observer_t observer) {
+  assert(state_machine != NULL);
+  for (uint32_t i = 0; i < state_machine->observer_count; i++) {
+    if (state_machine->observers[i].observer == observer) {
+      return state_machine->observers[i].context;
+    }
+  }
+  return NULL;
+}
+
+state_machine_event_mask_t state_machine_accepted_events(const state_machine_t *state_machine) {
+  assert(state_machine != NULL);
+  return state_machine->accepted_events[state_machine->current_state];
+}
+
+int state_machine_accepts(const state_machine_t *state_machine, event_id_t event_id) {
+  assert(state_machine != NULL);
+  if (event_id >= MAX_EVENTS_PER_STATE) {
+    return 0;
+  }
+  return (state_machine->accepted_events[state_machine->current_state] >> event_id) & 1;
+}
+
+state_machine_state_mask_t state_machine_reachable_states(const state_machine_t *state_machine) {
+  assert(state_machine != NULL);
+  return state_machine->reachable_states[state_machine->current_state];
+}
+
+int state_machine_can_reach(const state_machine_t *state_machine, state_id_t state) {
   assert(state_machine != NULL);
   assert(state < STATE_MACHINE_STATE_MAX);
-  state_machine->state_table[state].state_on_exit = on_exit;
+  return (state_machine->reachable_states[state_machine->current_state] >> state) & 1;
+}
+
+int state_machine_peek(const state_machine_t *state_machine, event_id_t event_id, state_id_t *next_state) {
+  assert(state_machine != NULL);
+  assert(next_state != NULL);
+  if (!state_machine_accepts(state_machine, event_id)) {
+    return 0;
+  }
+  *next_state = state_machine->state_transitions[state_machine->current_state][event_id].next_state;
+  return 1;
 }
@@ -33,36 +33,121 @@ extern "C" {
 #define MAX_EVENTS_PER_STATE 20
 #define STATE_MACHINE_STATE_MAX 10
 
+// Query indexes keep one bit per event or state in a single word
+#if MAX_EVENTS_PER_STATE > 32 || STATE_MACHINE_STATE_MAX > 32
+#error "MAX_EVENTS_PER_STATE and STATE_MACHINE_STATE_MAX must not exceed 32"
+#endif
+
 typedef uint32_t state_id_t;
+typedef uint32_t state_machine_event_mask_t;
+typedef uint32_t state_machine_state_mask_t;
 typedef void (*state_machine_event_handler_t)(event_t event);
 typedef int (*state_machine_guard_t)(event_t event);
 
+// Handlers receiving the event by pointer and the instance context
+typedef void (*state_machine_action_t)(const event_t *event, void *context);
+typedef int (*state_machine_action_guard_t)(const event_t *event, void *context);
+
+// A handler or guard slot holds either signature, the owner's flags say which
+typedef union {
+  state_machine_event_handler_t handler;
+  state_machine_action_t action;
+} state_machine_handler_t;
+
+typedef union {
+  state_machine_guard_t guard;
+  state_machine_action_guard_t action_guard;
+} state_machine_guard_slot_t;
+
+// state_table_entry_t flags
+#define STATE_MACHINE_BOUND_ENTER 0x1  // has its own context, see *_with_context
+#define STATE_MACHINE_BOUND_EXIT 0x2
+#define STATE_MACHINE_LEGACY_ENTER 0x4  // by-value signature, called directly
+#define STATE_MACHINE_LEGACY_EXIT 0x8
+
+// state_machine_transition_t flags
+#define STATE_MACHINE_BOUND_ACTION 0x1
+#define STATE_MACHINE_BOUND_GUARD 0x2
+#define STATE_MACHINE_LEGACY_ACTION 0x4
+#define STATE_MACHINE_LEGACY_GUARD 0x8
+
+// Signatures installed anywhere in a machine, a machine using only one kind (or none)
+// dispatches without testing the per-slot LEGACY_* flags
+#define STATE_MACHINE_KIND_LEGACY 0x1
+#define STATE_MACHINE_KIND_ACTION 0x2
+
 typedef struct {
   state_id_t state;
-  state_machine_event_handler_t state_on_enter;
-  state_machine_event_handler_t state_on_exit;
+  uint8_t flags;
+  state_machine_handler_t state_on_enter;
+  state_machine_handler_t state_on_exit;
+  // Instance context unless bound, unused by legacy handlers
+  void *on_enter_context;
+  void *on_exit_context;
 } state_table_entry_t;
 
 typedef struct {
-  int init;
+  uint8_t init;
+  uint8_t flags;
   state_id_t current_state;
   state_id_t next_state;
   event_id_t event_id;
-  state_machine_event_handler_t on_transition;
-  state_machine_guard_t guard;
+  state_machine_handler_t on_transition;
+  state_machine_guard_slot_t guard;
+  void *action_context;
+  void *guard_context;
 } state_machine_transition_t;
 
+// Observers are told about every event dispatched through an instance and about
+// its destruction, optional modules such as state_machine_shm.h and state_machine_group.h
+// attach this way
+#define STATE_MACHINE_OBSERVERS_MAX 4
+
+#define STATE_MACHINE_NOTIFY_EVENT 0       // event processed without a transition
+#define STATE_MACHINE_NOTIFY_TRANSITION 1  // event caused a transition
+#define STATE_MACHINE_NOTIFY_DESTROY 2     // instance is about to be freed
+
+struct state_machine;
+typedef void (*state_machine_observer_t)(struct state_machine *state_machine, int notification, void *context);
+
 typedef struct {
+  state_machine_observer_t observer;
+  void *context;
+} state_machine_observer_entry_t;
+
+// Inverse state index an instance is listed in, see state_machine_group.h
+struct state_machine_group;
+
+typedef struct state_machine {
   state_table_entry_t state_table[STATE_MACHINE_STATE_MAX];
   state_id_t initial_state;
   state_id_t current_state;
+  void *context;
+  state_machine_observer_entry_t observers[STATE_MACHINE_OBSERVERS_MAX];
+  uint32_t observer_count;
+  // Intrusive links into group->instances[group_state]
+  struct state_machine_group *group;
+  struct state_machine *group_prev;
+  struct state_machine *group_next;
+  state_id_t group_state;
+  uint32_t group_stamp;
   state_machine_transition_t state_transitions[STATE_MACHINE_STATE_MAX][MAX_EVENTS_PER_STATE];
+  // Rebuilt whenever a transition is added, bit n set for event id / state n
+  state_machine_event_mask_t accepted_events[STATE_MACHINE_STATE_MAX];
+  state_machine_state_mask_t reachable_states[STATE_MACHINE_STATE_MAX];
+  // Rebuilt whenever a handler or guard is assigned, STATE_MACHINE_KIND_* bits
+  uint8_t handler_kinds;
 } state_machine_t;
 
 
 state_machine_t *state_machine_create(state_id_t initial_state);
 void state_machine_destroy(state_machine_t *state_machine);
 void state_machine_event(state_machine_t *state_machine, event_t event);
+void state_machine_dispatch(state_machine_t *state_machine, const event_t *event);
+void state_machine_set_context(state_machine_t *state_machine, void *context);
+// Run event against definition for an instance whose state is kept elsewhere,
+// definition is only read. Returns 1 if the event caused a transition.
+int state_machine_dispatch_state(const state_machine_t *definition, state_id_t *current_state, const event_t *event);
 void state_machine_add_transition(
     state_machine_t *state_machine, 
     state_id_t state_a, 
@@ -81,6 +166,49 @@ void state_machine_add_transition_with_guard(
 void state_machine_assign_on_enter_handler(state_machine_t *state_machine, state_id_t state, state_machine_event_handler_t on_enter);
 void state_machine_assign_on_exit_handler(state_machine_t *state_machine, state_id_t state, state_machine_event_handler_t on_exit);
 
+// Pointer-passing variants, replace any handler previously assigned to the same slot
+void state_machine_add_transition_action(
+    state_machine_t *state_machine,
+    state_id_t state_a,
+    state_id_t state_b,
+    event_id_t event_id,
+    state_machine_action_t on_transition,
+    state_machine_action_guard_t guard);
+void state_machine_assign_on_enter_action(state_machine_t *state_machine, state_id_t state, state_machine_action_t on_enter);
+void state_machine_assign_on_exit_action(state_machine_t *state_machine, state_id_t state, state_machine_action_t on_exit);
+// As above, but each handler receives its own context instead of the instance context
+void state_machine_add_transition_action_with_context(
+    state_machine_t *state_machine,
+    state_id_t state_a,
+    state_id_t state_b,
+    event_id_t event_id,
+    state_machine_action_t on_transition,
+    void *transition_context,
+    state_machine_action_guard_t guard,
+    void *guard_context);
+void state_machine_assign_on_enter_action_with_context(
+    state_machine_t *state_machine, state_id_t state, state_machine_action_t on_enter, void *context);
+void state_machine_assign_on_exit_action_with_context(
+    state_machine_t *state_machine, state_id_t state, state_machine_action_t on_exit, void *context);
+
+// Observers run in the order they were added, after every event and once on destroy.
+// They must not add or remove observers while being notified of an event.
+// Returns 0, or -1 if STATE_MACHINE_OBSERVERS_MAX observers are already attached.
+int state_machine_add_observer(state_machine_t *state_machine, state_machine_observer_t observer, void *context);
+// Returns 0, or -1 if the observer was not attached with that context
+int state_machine_remove_observer(state_machine_t *state_machine, state_machine_observer_t observer, void *context);
+// Context of the first observer attached with observer, NULL if there is none
+void *state_machine_observer_context(const state_machine_t *state_machine, state_machine_observer_t observer);
+
+// Read-only queries against the current state, guards are never evaluated
+state_machine_event_mask_t state_machine_accepted_events(const state_machine_t *state_machine);
+int state_machine_accepts(const state_machine_t *state_machine, event_id_t event_id);
+// Reachable in zero or more transitions, assuming every guard can pass
+state_machine_state_mask_t state_machine_reachable_states(const state_machine_t *state_machine);
+int state_machine_can_reach(const state_machine_t *state_machine, state_id_t state);
+// Returns 1 and the target state if event_id has a transition here, 0 otherwise
+int state_machine_peek(const state_machine_t *state_machine, event_id_t event_id, state_id_t *next_state);
+
 #ifdef __cplusplus
 }
 #endif // __cplusplus
@@ -0,0 +1,255 @@
+/**
+ * Copyright (c) 2025 Nicholas Daniell
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef STATE_MACHINE_HPP
+#define STATE_MACHINE_HPP
+
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "state_machine.h"
+
+namespace esm {
+
+namespace detail {
+
+// Owns one callable of any type, in place when it fits. Only storage and
+// destruction are type-erased, calls go through invoke_action / invoke_guard
+// instantiated for the concrete type.
+class handler_storage {
+ public:
+  static constexpr std::size_t inline_size = 4 * sizeof(void *);
+
+  handler_storage() noexcept = default;
+  ~handler_storage() { reset(); }
+  handler_storage(const handler_storage &) = delete;
+  handler_storage &operator=(const handler_storage &) = delete;
+
+  template <typename F>
+  typename std::decay<F>::type *emplace(F &&callable) {
+    typedef typename std::decay<F>::type T;
+    typedef std::integral_constant<bool, sizeof(T) <= inline_size && alignof(T) <= alignof(std::max_align_t)> fits;
+    reset();
+    target_ = construct<T>(std::forward<F>(callable), fits());
+    return static_cast<T *>(target_);
+  }
+
+  void reset() noexcept {
+    if (destroy_) {
+      destroy_(target_);
+      destroy_ = nullptr;
+      target_ = nullptr;
+    }
+  }
+
+  bool is_inline() const noexcept { return target_ == static_cast<const void *>(buffer_); }
+
+ private:
+  template <typename T, typename F>
+  void *construct(F &&callable, std::true_type) {
+    void *target = new (buffer_) T(std::forward<F>(callable));
+    destroy_ = &destroy_inline<T>;
+    return target;
+  }
+
+  // Allocated once here, never while dispatching
+  template <typename T, typename F>
+  void *construct(F &&callable, std::false_type) {
+    void *target = new T(std::forward<F>(callable));
+    destroy_ = &destroy_heap<T>;
+    return target;
+  }
+
+  template <typename T>
+  static void destroy_inline(void *target) noexcept { static_cast<T *>(target)->~T(); }
+  template <typename T>
+  static void destroy_heap(void *target) noexcept { delete static_cast<T *>(target); }
+
+  alignas(std::max_align_t) unsigned char buffer_[inline_size];
+  void *target_ = nullptr;
+  void (*destroy_)(void *) = nullptr;
+};
+
+template <typename T>
+void invoke_action(const event_t *event, void *context) {
+  (*static_cast<T *>(context))(*event);
+}
+
+template <typename T>
+int invoke_guard(const event_t *event, void *context) {
+  return (*static_cast<T *>(context))(*event) ? 1 : 0;
+}
+
+// Heap allocated once per instance so handler addresses survive moves
+struct handler_table {
+  handler_storage on_enter[STATE_MACHINE_STATE_MAX];
+  handler_storage on_exit[STATE_MACHINE_STATE_MAX];
+  handler_storage on_transition[STATE_MACHINE_STATE_MAX][MAX_EVENTS_PER_STATE];
+  handler_storage guard[STATE_MACHINE_STATE_MAX][MAX_EVENTS_PER_STATE];
+};
+
+}  // namespace detail
+
+// Move-only owner of a state_machine_t. Handlers are any callable taking
+// const event_t & (guards return something convertible to bool), each one is
+// bound through the C *_with_context slots with its own context, so a transition
+// costs the same indirect calls as plain C function pointers.
+class state_machine {
+ public:
+  explicit state_machine(state_id_t initial_state)
+      : handlers_(new detail::handler_table()), machine_(state_machine_create(initial_state)) {
+    if (!machine_) {
+      throw std::bad_alloc();
+    }
+  }
+
+  ~state_machine() {
+    if (machine_) {
+      state_machine_destroy(machine_);
+    }
+  }
+
+  state_machine(state_machine &&other) noexcept
+      : handlers_(std::move(other.handlers_)), machine_(other.machine_) {
+    other.machine_ = nullptr;
+  }
+
+  state_machine &operator=(state_machine &&other) noexcept {
+    if (this != &other) {
+      if (machine_) {
+        state_machine_destroy(machine_);
+      }
+      handlers_ = std::move(other.handlers_);
+      machine_ = other.machine_;
+      other.machine_ = nullptr;
+    }
+    return *this;
+  }
+
+  state_machine(const state_machine &) = delete;
+  state_machine &operator=(const state_machine &) = delete;
+
+  void add_transition(state_id_t state_a, state_id_t state_b, event_id_t event_id) {
+    set_transition(state_a, state_b, event_id, nullptr, nullptr, nullptr, nullptr);
+  }
+
+  template <typename F>
+  void add_transition(state_id_t state_a, state_id_t state_b, event_id_t event_id, F &&on_transition) {
+    typedef typename std::decay<F>::type T;
+    detail::handler_storage &slot = transition_slot(state_a, state_b, event_id);
+    T *target = slot.emplace(std::forward<F>(on_transition));
+    set_transition(state_a, state_b, event_id, &detail::invoke_action<T>, target, nullptr, nullptr);
+  }
+
+  template <typename F, typename G>
+  void add_transition(state_id_t state_a, state_id_t state_b, event_id_t event_id, F &&on_transition, G &&guard) {
+    typedef typename std::decay<F>::type T;
+    typedef typename std::decay<G>::type U;
+    detail::handler_storage &slot = transition_slot(state_a, state_b, event_id);
+    T *target = slot.emplace(std::forward<F>(on_transition));
+    U *guard_target = handlers_->guard[state_a][event_id].emplace(std::forward<G>(guard));
+    set_transition(state_a, state_b, event_id, &detail::invoke_action<T>, target,
+                   &detail::invoke_guard<U>, guard_target);
+  }
+
+  template <typename G>
+  void add_transition(state_id_t state_a, state_id_t state_b, event_id_t event_id, std::nullptr_t, G &&guard) {
+    typedef typename std::decay<G>::type U;
+    transition_slot(state_a, state_b, event_id);
+    U *guard_target = handlers_->guard[state_a][event_id].emplace(std::forward<G>(guard));
+    set_transition(state_a, state_b, event_id, nullptr, nullptr, &detail::invoke_guard<U>, guard_target);
+  }
+
+  template <typename F>
+  void on_enter(state_id_t state, F &&handler) {
+    typedef typename std::decay<F>::type T;
+    assert(machine_ && state < STATE_MACHINE_STATE_MAX);
+    // Unbind first so a throwing constructor never leaves a dangling context
+    state_machine_assign_on_enter_action(machine_, state, nullptr);
+    T *target = handlers_->on_enter[state].emplace(std::forward<F>(handler));
+    state_machine_assign_on_enter_action_with_context(machine_, state, &detail::invoke_action<T>, target);
+  }
+
+  template <typename F>
+  void on_exit(state_id_t state, F &&handler) {
+    typedef typename std::decay<F>::type T;
+    assert(machine_ && state < STATE_MACHINE_STATE_MAX);
+    state_machine_assign_on_exit_action(machine_, state, nullptr);
+    T *target = handlers_->on_exit[state].emplace(std::forward<F>(handler));
+    state_machine_assign_on_exit_action_with_context(machine_, state, &detail::invoke_action<T>, target);
+  }
+
+  void dispatch(const event_t &event) {
+    assert(machine_);
+    state_machine_dispatch(machine_, &event);
+  }
+
+  state_id_t current_state() const noexcept {
+    assert(machine_);
+    return machine_->current_state;
+  }
+  bool accepts(event_id_t event_id) const noexcept { return state_machine_accepts(machine_, event_id) != 0; }
+  bool can_reach(state_id_t state) const noexcept { return state_machine_can_reach(machine_, state) != 0; }
+  bool peek(event_id_t event_id, state_id_t *next_state) const noexcept {
+    return state_machine_peek(machine_, event_id, next_state) != 0;
+  }
+
+  // For the C modules (queues, groups, shared memory), ownership stays here
+  state_machine_t *get() noexcept { return machine_; }
+  const state_machine_t *get() const noexcept { return machine_; }
+  explicit operator bool() const noexcept { return machine_ != nullptr; }
+
+ private:
+  // Unbinds an existing transition before its storage is replaced
+  detail::handler_storage &transition_slot(state_id_t state_a, state_id_t state_b, event_id_t event_id) {
+    assert(machine_ && state_a < STATE_MACHINE_STATE_MAX && event_id < MAX_EVENTS_PER_STATE);
+    if (machine_->state_transitions[state_a][event_id].init) {
+      state_machine_add_transition_action(machine_, state_a, state_b, event_id, nullptr, nullptr);
+    }
+    handlers_->guard[state_a][event_id].reset();
+    return handlers_->on_transition[state_a][event_id];
+  }
+
+  void set_transition(state_id_t state_a, state_id_t state_b, event_id_t event_id,
+                      state_machine_action_t action, void *action_context,
+                      state_machine_action_guard_t guard, void *guard_context) {
+    assert(machine_ && state_a < STATE_MACHINE_STATE_MAX && event_id < MAX_EVENTS_PER_STATE);
+    state_machine_add_transition_action_with_context(machine_, state_a, state_b, event_id,
+                                                     action, action_context, guard, guard_context);
+    if (!action) {
+      handlers_->on_transition[state_a][event_id].reset();
+    }
+    if (!guard) {
+      handlers_->guard[state_a][event_id].reset();
+    }
+  }
+
+  std::unique_ptr<detail::handler_table> handlers_;
+  state_machine_t *machine_;
+};
+
+}  // namespace esm
+
+#endif /* STATE_MACHINE_HPP */
@@ -0,0 +1,278 @@
+/**
+ * Copyright (c) 2025 Nicholas Daniell
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#define _GNU_SOURCE
+#include "state_machine_dispatcher.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#endif
+
+#define STATE_MACHINE_DISPATCHER_RUNNING 0
+#define STATE_MACHINE_DISPATCHER_PARKED 1
+
+static inline void state_machine_dispatcher_cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  __asm__ __volatile__("yield");
+#endif
+}
+
+state_machine_dispatcher_t *state_machine_dispatcher_create(
+    state_machine_t *state_machine,
+    state_machine_queue_t *queue,
+    int flags) {
+  assert(state_machine != NULL);
+  assert(queue != NULL);
+  state_machine_dispatcher_t *dispatcher = (state_machine_dispatcher_t *)calloc(1, sizeof(state_machine_dispatcher_t));
+  assert(dispatcher != NULL);
+  dispatcher->state_machine = state_machine;
+  dispatcher->queue = queue;
+  dispatcher->flags = flags;
+  dispatcher->event_fd = -1;
+  dispatcher->spin_max = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? STATE_MACHINE_DISPATCHER_SPIN_MAX : 0;
+  dispatcher->spin_limit = dispatcher->spin_max ? STATE_MACHINE_DISPATCHER_SPIN_MIN : 0;
+  atomic_init(&dispatcher->pending, state_machine_queue_count(queue));
+  atomic_init(&dispatcher->stopping, 0);
+  atomic_init(&dispatcher->parked, STATE_MACHINE_DISPATCHER_RUNNING);
+  atomic_init(&dispatcher->wakes, 0);
+  pthread_mutex_init(&dispatcher->lock, NULL);
+#ifndef __linux__
+  pthread_cond_init(&dispatcher->wake_cond, NULL);
+#endif
+
+  if (flags & STATE_MACHINE_DISPATCHER_EVENTFD) {
+#ifdef __linux__
+    dispatcher->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#endif
+    if (dispatcher->event_fd < 0) {
+      state_machine_dispatcher_destroy(dispatcher);
+      return NULL;
+    }
+  }
+  return dispatcher;
+}
+
+void state_machine_dispatcher_destroy(state_machine_dispatcher_t *dispatcher) {
+  assert(dispatcher != NULL);
+#ifdef __linux__
+  if (dispatcher->event_fd >= 0) {
+    close(dispatcher->event_fd);
+  }
+#else
+  pthread_cond_destroy(&dispatcher->wake_cond);
+#endif
+  pthread_mutex_destroy(&dispatcher->lock);
+  free(dispatcher);
+}
+
+static void state_machine_dispatcher_signal(state_machine_dispatcher_t *dispatcher) {
+#ifdef __linux__
+  if (dispatcher->event_fd >= 0) {
+    uint64_t one = 1;
+    // Only fails if the counter would overflow, the fd is readable either way
+    if (write(dispatcher->event_fd, &one, sizeof(one)) < 0) {
+      return;
+    }
+  } else {
+    syscall(SYS_futex, (uint32_t *)&dispatcher->parked, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+  }
+#else
+  pthread_mutex_lock(&dispatcher->lock);
+  pthread_cond_signal(&dispatcher->wake_cond);
+  pthread_mutex_unlock(&dispatcher->lock);
+#endif
+}
+
+// Pairs with prepare_wait: either the consumer sees pending, or we see it parked.
+// The exchange lets exactly one producer pay for the syscall per park.
+static void state_machine_dispatcher_wake(state_machine_dispatcher_t *dispatcher) {
+  if (atomic_load(&dispatcher->parked) == STATE_MACHINE_DISPATCHER_PARKED &&
+      atomic_exchange(&dispatcher->parked, STATE_MACHINE_DISPATCHER_RUNNING) == STATE_MACHINE_DISPATCHER_PARKED) {
+    atomic_fetch_add_explicit(&dispatcher->wakes, 1, memory_order_relaxed);
+    state_machine_dispatcher_signal(dispatcher);
+  }
+}
+
+int state_machine_dispatcher_post(state_machine_dispatcher_t *dispatcher, event_t event) {
+  assert(dispatcher != NULL);
+  pthread_mutex_lock(&dispatcher->lock);
+  int result = state_machine_queue_post(dispatcher->queue, event);
+  atomic_store(&dispatcher->pending, state_machine_queue_count(dispatcher->queue));
+  pthread_mutex_unlock(&dispatcher->lock);
+
+  if (result == 0) {
+    state_machine_dispatcher_wake(dispatcher);
+  }
+  return result;
+}
+
+int state_machine_dispatcher_prepare_wait(state_machine_dispatcher_t *dispatcher) {
+  assert(dispatcher != NULL);
+  atomic_store(&dispatcher->parked, STATE_MACHINE_DISPATCHER_PARKED);
+  if (atomic_load(&dispatcher->pending) || atomic_load(&dispatcher->stopping)) {
+    atomic_store(&dispatcher->parked, STATE_MACHINE_DISPATCHER_RUNNING);
+    return 1;
+  }
+  dispatcher->armed = 1;
+  dispatcher->parks++;
+  return 0;
+}
+
+static void state_machine_dispatcher_park(state_machine_dispatcher_t *dispatcher, int timeout_ms) {
+#ifdef __linux__
+  if (dispatcher->event_fd >= 0) {
+    struct pollfd fd = {dispatcher->event_fd, POLLIN, 0};
+    poll(&fd, 1, timeout_ms);
+  } else {
+    struct timespec timeout = {timeout_ms / 1000, (long)(timeout_ms % 1000) * 1000000L};
+    // Returns at once if a producer already flipped the word back
+    syscall(SYS_futex, (uint32_t *)&dispatcher->parked, FUTEX_WAIT_PRIVATE, STATE_MACHINE_DISPATCHER_PARKED,
+            timeout_ms < 0 ? NULL : &timeout, NULL, 0);
+  }
+#else
+  struct timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  deadline.tv_sec += timeout_ms / 1000;
+  deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+  if (deadline.tv_nsec >= 1000000000L) {
+    deadline.tv_sec++;
+    deadline.tv_nsec -= 1000000000L;
+  }
+  pthread_mutex_lock(&dispatcher->lock);
+  while (atomic_load(&dispatcher->parked) == STATE_MACHINE_DISPATCHER_PARKED) {
+    if (timeout_ms < 0) {
+      pthread_cond_wait(&dispatcher->wake_cond, &dispatcher->lock);
+    } else if (pthread_cond_timedwait(&dispatcher->wake_cond, &dispatcher->lock, &deadline) != 0) {
+      break;
+    }
+  }
+  pthread_mutex_unlock(&dispatcher->lock);
+#endif
+}
+
+uint32_t state_machine_dispatcher_run_once(state_machine_dispatcher_t *dispatcher) {
+  assert(dispatcher != NULL);
+  atomic_store(&dispatcher->parked, STATE_MACHINE_DISPATCHER_RUNNING);
+#ifdef __linux__
+  if (dispatcher->armed && dispatcher->event_fd >= 0) {
+    uint64_t count;
+    // Non-blocking, a wakeup still in flight is cleared on the next pass
+    if (read(dispatcher->event_fd, &count, sizeof(count)) < 0) {
+      count = 0;
+    }
+  }
+#endif
+  dispatcher->armed = 0;
+
+  // Take a whole batch per lock acquisition and run it unlocked. The tracker is
+  // fixed while the dispatcher exists, so it is safe to read outside the lock.
+  state_machine_latency_t *latency = dispatcher->queue->latency;
+  event_t batch[STATE_MACHINE_QUEUE_SIZE];
+  uint64_t posted_ns[STATE_MACHINE_QUEUE_SIZE];
+  uint32_t total = 0;
+  for (;;) {
+    uint32_t count = 0;
+    pthread_mutex_lock(&dispatcher->lock);
+    while (count < STATE_MACHINE_QUEUE_SIZE &&
+           state_machine_queue_pop_stamped(dispatcher->queue, &batch[count], &posted_ns[count])) {
+      count++;
+    }
+    atomic_store(&dispatcher->pending, state_machine_queue_count(dispatcher->queue));
+    pthread_mutex_unlock(&dispatcher->lock);
+
+    if (count == 0) {
+      return total;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+      if (latency) {
+        state_id_t state = dispatcher->state_machine->current_state;
+        uint64_t start_ns = state_machine_latency_now();
+        state_machine_dispatch(dispatcher->state_machine, &batch[i]);
+        state_machine_latency_record(latency, state, batch[i].event_id, posted_ns[i], start_ns,
+                                     state_machine_latency_now());
+      } else {
+        state_machine_dispatch(dispatcher->state_machine, &batch[i]);
+      }
+    }
+    total += count;
+  }
+}
+
+uint32_t state_machine_dispatcher_wait(state_machine_dispatcher_t *dispatcher, int timeout_ms) {
+  assert(dispatcher != NULL);
+  uint32_t dispatched = state_machine_dispatcher_run_once(dispatcher);
+  if (dispatched) {
+    return dispatched;
+  }
+
+  // Spin while posts keep arriving within the window, back off when they don't
+  for (uint32_t i = 0; i < dispatcher->spin_limit; i++) {
+    if (atomic_load_explicit(&dispatcher->pending, memory_order_relaxed) ||
+        atomic_load_explicit(&dispatcher->stopping, memory_order_relaxed)) {
+      break;
+    }
+    state_machine_dispatcher_cpu_relax();
+  }
+  if (atomic_load(&dispatcher->pending)) {
+    dispatcher->spin_hits++;
+    if (dispatcher->spin_limit < dispatcher->spin_max) {
+      dispatcher->spin_limit *= 2;
+    }
+    return state_machine_dispatcher_run_once(dispatcher);
+  }
+  if (dispatcher->spin_limit > STATE_MACHINE_DISPATCHER_SPIN_MIN) {
+    dispatcher->spin_limit /= 2;
+  }
+
+  if (state_machine_dispatcher_prepare_wait(dispatcher) == 0) {
+    state_machine_dispatcher_park(dispatcher, timeout_ms);
+  }
+  return state_machine_dispatcher_run_once(dispatcher);
+}
+
+void *state_machine_dispatcher_run(void *dispatcher) {
+  state_machine_dispatcher_t *self = (state_machine_dispatcher_t *)dispatcher;
+  assert(self != NULL);
+  while (!atomic_load(&self->stopping)) {
+    state_machine_dispatcher_wait(self, -1);
+  }
+  state_machine_dispatcher_run_once(self);
+  return NULL;
+}
+
+void state_machine_dispatcher_stop(state_machine_dispatcher_t *dispatcher) {
+  assert(dispatcher != NULL);
+  atomic_store(&dispatcher->stopping, 1);
+  state_machine_dispatcher_wake(dispatcher);
+}
+
+int state_machine_dispatcher_fd(const state_machine_dispatcher_t *dispatcher) {
+  assert(dispatcher != NULL);
+  return dispatcher->event_fd;
+}
@@ -0,0 +1,103 @@
+/**
+ * Copyright (c) 2025 Nicholas Daniell
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef STATE_MACHINE_DISPATCHER_H
+#define STATE_MACHINE_DISPATCHER_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "state_machine.h"
+#include "state_machine_queue.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+// Park on an eventfd that an external epoll loop can watch, Linux only
+#define STATE_MACHINE_DISPATCHER_EVENTFD 0x1
+
+// Bounds of the adaptive spin before parking, in polls of the pending count
+#define STATE_MACHINE_DISPATCHER_SPIN_MIN 16
+#define STATE_MACHINE_DISPATCHER_SPIN_MAX 4096
+
+typedef struct {
+  state_machine_t *state_machine;
+  state_machine_queue_t *queue;
+  int flags;
+  int event_fd;  // -1 unless STATE_MACHINE_DISPATCHER_EVENTFD
+  // Producers post under the lock, the consumer only holds it to take a batch
+  pthread_mutex_t lock;
+  _Atomic uint32_t pending;
+  _Atomic int stopping;
+  // Futex word, 1 while the consumer is parked or about to park
+  _Alignas(64) _Atomic uint32_t parked;
+  _Atomic uint64_t wakes;  // wake syscalls issued by producers
+#ifndef __linux__
+  pthread_cond_t wake_cond;
+#endif
+  // Consumer only
+  _Alignas(64) uint32_t spin_limit;
+  uint32_t spin_max;  // 0 on a single CPU, where spinning only delays the producer
+  int armed;  // parked since the last run_once, the eventfd may need clearing
+  uint64_t parks;
+  uint64_t spin_hits;
+} state_machine_dispatcher_t;
+
+// Dispatches queue into state_machine from a single consumer thread. The queue
+// is configured beforehand, including its latency tracker which the consumer
+// records into, and must not be used directly while the dispatcher exists.
+// Returns NULL if STATE_MACHINE_DISPATCHER_EVENTFD is unavailable.
+state_machine_dispatcher_t *state_machine_dispatcher_create(
+    state_machine_t *state_machine,
+    state_machine_queue_t *queue,
+    int flags);
+void state_machine_dispatcher_destroy(state_machine_dispatcher_t *dispatcher);
+
+// Safe from any thread. Only issues a wake syscall if the consumer is parked,
+// concurrent posts to a parked consumer share one wakeup.
+// Returns 0 on success (including when coalesced), -1 if the queue is full
+int state_machine_dispatcher_post(state_machine_dispatcher_t *dispatcher, event_t event);
+
+// Consumer side. Dispatches every pending event without blocking and returns
+// the number dispatched, events run outside the lock so handlers may post.
+uint32_t state_machine_dispatcher_run_once(state_machine_dispatcher_t *dispatcher);
+// Spins, then parks until events arrive, timeout_ms elapses (-1 waits forever)
+// or the dispatcher is stopped. Returns the number of events dispatched.
+uint32_t state_machine_dispatcher_wait(state_machine_dispatcher_t *dispatcher, int timeout_ms);
+// Loops on state_machine_dispatcher_wait until stopped, suitable as a thread body
+void *state_machine_dispatcher_run(void *dispatcher);
+// Safe from any thread, wakes the consumer
+void state_machine_dispatcher_stop(state_machine_dispatcher_t *dispatcher);
+
+// External loops: poll the fd for readability and call run_once when it fires.
+// Returns -1 without STATE_MACHINE_DISPATCHER_EVENTFD.
+int state_machine_dispatcher_fd(const state_machine_dispatcher_t *dispatcher);
+// Marks the consumer parked before blocking on the fd. Returns 0 if the loop may
+// block, 1 if events are already pending and run_once should be called instead.
+int state_machine_dispatcher_prepare_wait(state_machine_dispatcher_t *dispatcher);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif /* STATE_MACHINE_DISPATCHER_H */
@@ -0,0 +1,156 @@
+/**
+ * Copyright (c) 2025 Nicholas Daniell
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "state_machine_group.h"
+#include <assert.h>
+#include <stdlib.h>
+
+static void state_machine_group_link(state_machine_group_t *group, state_machine_t *state_machine) {
+  state_id_t state = state_machine->current_state;
+  assert(state < STATE_MACHINE_STATE_MAX);
+
+  // New members go to the head, so a running broadcast does not walk into them
+  state_machine->group_state = state;
+  state_machine->group_prev = NULL;
+  state_machine->group_next = group->instances[state];
+  if (group->instances[state]) {
+    group->instances[state]->group_prev = state_machine;
+  }
+  group->instances[state] = state_machine;
+  group->population[state]++;
+}
+
+static void state_machine_group_unlink(state_machine_group_t *group, state_machine_t *state_machine) {
+  state_id_t state = state_machine->group_state;
+
+  if (state_machine->group_prev) {
+    state_machine->group_prev->group_next = state_machine->group_next;
+  } else {
+    group->instances[state] = state_machine->group_next;
+  }
+  if (state_machine->group_next) {
+    state_machine->group_next->group_prev = state_machine->group_prev;
+  }
+  state_machine->group_prev = NULL;
+  state_machine->group_next = NULL;
+  group->population[state]--;
+}
+
+// Relink an instance whose current_state changed
+static void state_machine_group_update(state_machine_group_t *group, state_machine_t *state_machine) {
+  assert(state_machine->group == group);
+  state_machine_group_unlink(group, state_machine);
+  state_machine_group_link(group, state_machine);
+}
+
+static void state_machine_group_observer(state_machine_t *state_machine, int notification, void *context) {
+  state_machine_group_t *group = (state_machine_group_t *)context;
+  if (notification == STATE_MACHINE_NOTIFY_DESTROY) {
+    state_machine_group_remove(group, state_machine);
+  } else if (state_machine->group_state != state_machine->current_state) {
+    state_machine_group_update(group, state_machine);
+  }
+}
+
+state_machine_group_t *state_machine_group_create(void) {
+  state_machine_group_t *group = (state_machine_group_t *)calloc(1, sizeof(state_machine_group_t));
+  assert(group != NULL);
+  return group;
+}
+
+void state_machine_group_destroy(state_machine_group_t *group) {
+  assert(group != NULL);
+  for (int state = 0; state < STATE_MACHINE_STATE_MAX; state++) {
+    while (group->instances[state]) {
+      state_machine_group_remove(group, group->instances[state]);
+    }
+  }
+  free(group);
+}
+
+void state_machine_group_add(state_machine_group_t *group, state_machine_t *state_machine) {
+  assert(group != NULL);
+  assert(state_machine != NULL);
+  assert(state_machine->group == NULL);
+
+  int attached = state_machine_add_observer(state_machine, state_machine_group_observer, group);
+  assert(attached == 0);
+  (void)attached;
+  state_machine->group = group;
+  state_machine->group_stamp = group->broadcast_stamp;
+  state_machine_group_link(group, state_machine);
+  group->count++;
+}
+
+void state_machine_group_remove(state_machine_group_t *group, state_machine_t *state_machine) {
+  assert(group != NULL);
+  assert(state_machine != NULL);
+  assert(state_machine->group == group);
+
+  state_machine_remove_observer(state_machine, state_machine_group_observer, group);
+  state_machine_group_unlink(group, state_machine);
+  state_machine->group = NULL;
+  group->count--;
+}
+
+uint32_t state_machine_group_population(const state_machine_group_t *group, state_id_t state) {
+  assert(group != NULL);
+  assert(state < STATE_MACHINE_STATE_MAX);
+  return group->population[state];
+}
+
+state_machine_t *state_machine_group_first(const state_machine_group_t *group, state_id_t state) {
+  assert(group != NULL);
+  assert(state < STATE_MACHINE_STATE_MAX);
+  return group->instances[state];
+}
+
+state_machine_t *state_machine_group_next(const state_machine_t *state_machine) {
+  assert(state_machine != NULL);
+  return state_machine->group_next;
+}
+
+uint32_t state_machine_group_broadcast(state_machine_group_t *group, state_id_t state, const event_t *event) {
+  assert(group != NULL);
+  assert(state < STATE_MACHINE_STATE_MAX);
+  assert(event != NULL);
+
+  // Stamp instances as they are visited so a restarted walk skips them
+  uint32_t stamp = ++group->broadcast_stamp;
+  uint32_t sent = 0;
+
+  state_machine_t *state_machine = group->instances[state];
+  while (state_machine) {
+    state_machine_t *next = state_machine->group_next;
+    if (state_machine->group_stamp != stamp) {
+      state_machine->group_stamp = stamp;
+      state_machine_dispatch(state_machine, event);
+      sent++;
+    }
+
+    // Handlers may have moved the saved successor to another list, start over
+    if (next && (next->group != group || next->group_state != state)) {
+      next = group->instances[state];
+    }
+    state_machine = next;
+  }
+  return sent;
+}
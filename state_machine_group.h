@@ -0,0 +1,65 @@
+/**
+ * Copyright (c) 2025 Nicholas Daniell
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef STATE_MACHINE_GROUP_H
+#define STATE_MACHINE_GROUP_H
+
+#include <stdint.h>
+
+#include "state_machine.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+// Inverse state index over a set of instances: one intrusive list per state, kept
+// current through an observer as instances transition
+typedef struct state_machine_group {
+  state_machine_t *instances[STATE_MACHINE_STATE_MAX];
+  uint32_t population[STATE_MACHINE_STATE_MAX];
+  uint32_t count;
+  uint32_t broadcast_stamp;
+} state_machine_group_t;
+
+state_machine_group_t *state_machine_group_create(void);
+// Instances still in the group are removed, not destroyed
+void state_machine_group_destroy(state_machine_group_t *group);
+
+// An instance belongs to at most one group and uses one of its observer slots,
+// destroying it removes it
+void state_machine_group_add(state_machine_group_t *group, state_machine_t *state_machine);
+void state_machine_group_remove(state_machine_group_t *group, state_machine_t *state_machine);
+
+uint32_t state_machine_group_population(const state_machine_group_t *group, state_id_t state);
+// Iterate instances in state: first, then state_machine_group_next() until NULL
+state_machine_t *state_machine_group_first(const state_machine_group_t *group, state_id_t state);
+state_machine_t *state_machine_group_next(const state_machine_t *state_machine);
+
+// Dispatch event to every instance in state, returns the number of instances it was sent to.
+// Each instance gets the event at most once. Instances that enter state while the
+// broadcast runs may or may not receive it. Handlers must not destroy group members.
+uint32_t state_machine_group_broadcast(state_machine_group_t *group, state_id_t state, const event_t *event);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif /* STATE_MACHINE_GROUP_H */
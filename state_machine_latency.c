@@ -0,0 +1,217 @@
+/**
+ * Copyright (c) 2025 Nicholas Daniell
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include "state_machine_latency.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define HALF_SUB_BUCKETS (STATE_MACHINE_HIST_SUB_BUCKETS / 2)
+
+uint64_t state_machine_latency_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static inline int state_machine_hist_index(uint64_t value) {
+  if (value < STATE_MACHINE_HIST_SUB_BUCKETS) {
+    return (int)value;
+  }
+  if (value >> STATE_MACHINE_HIST_MAX_BITS) {
+    return STATE_MACHINE_HIST_BUCKETS - 1;
+  }
+
+  // Keep the top SUB_BUCKET_BITS bits, the leading one selects the upper half
+  int msb = 63 - __builtin_clzll(value);
+  int shift = msb - (STATE_MACHINE_HIST_SUB_BUCKET_BITS - 1);
+  int mantissa = (int)(value >> shift);
+  return STATE_MACHINE_HIST_SUB_BUCKETS + (shift - 1) * HALF_SUB_BUCKETS + (mantissa - HALF_SUB_BUCKETS);
+}
+
+uint64_t state_machine_hist_bucket_low(int index) {
+  assert(index >= 0 && index < STATE_MACHINE_HIST_BUCKETS);
+  if (index < STATE_MACHINE_HIST_SUB_BUCKETS) {
+    return (uint64_t)index;
+  }
+  int offset = index - STATE_MACHINE_HIST_SUB_BUCKETS;
+  int shift = offset / HALF_SUB_BUCKETS + 1;
+  uint64_t mantissa = (uint64_t)(offset % HALF_SUB_BUCKETS + HALF_SUB_BUCKETS);
+  return mantissa << shift;
+}
+
+uint64_t state_machine_hist_bucket_high(int index) {
+  assert(index >= 0 && index < STATE_MACHINE_HIST_BUCKETS);
+  if (index == STATE_MACHINE_HIST_BUCKETS - 1) {
+    return UINT64_MAX;
+  }
+  return state_machine_hist_bucket_low(index + 1) - 1;
+}
+
+void state_machine_hist_reset(state_machine_hist_t *hist) {
+  assert(hist != NULL);
+  memset(hist, 0, sizeof(*hist));
+  hist->min_ns = UINT64_MAX;
+}
+
+void state_machine_hist_record(state_machine_hist_t *hist, uint64_t value_ns) {
+  hist->counts[state_machine_hist_index(value_ns)]++;
+  hist->total_count++;
+  hist->total_ns += value_ns;
+  if (value_ns < hist->min_ns) {
+    hist->min_ns = value_ns;
+  }
+  if (value_ns > hist->max_ns) {
+    hist->max_ns = value_ns;
+  }
+}
+
+void state_machine_hist_merge(state_machine_hist_t *hist, const state_machine_hist_t *other) {
+  assert(hist != NULL);
+  assert(other != NULL);
+  for (int i = 0; i < STATE_MACHINE_HIST_BUCKETS; i++) {
+    hist->counts[i] += other->counts[i];
+  }
+  hist->total_count += other->total_count;
+  hist->total_ns += other->total_ns;
+  if (other->min_ns < hist->min_ns) {
+    hist->min_ns = other->min_ns;
+  }
+  if (other->max_ns > hist->max_ns) {
+    hist->max_ns = other->max_ns;
+  }
+}
+
+uint64_t state_machine_hist_percentile(const state_machine_hist_t *hist, double percentile) {
+  assert(hist != NULL);
+  assert(percentile >= 0.0 && percentile <= 100.0);
+  if (hist->total_count == 0) {
+    return 0;
+  }
+
+  uint64_t target = (uint64_t)(percentile / 100.0 * (double)hist->total_count + 0.5);
+  if (target < 1) {
+    target = 1;
+  }
+
+  uint64_t seen = 0;
+  for (int i = 0; i < STATE_MACHINE_HIST_BUCKETS; i++) {
+    seen += hist->counts[i];
+    if (seen >= target) {
+      uint64_t high = state_machine_hist_bucket_high(i);
+      return high < hist->max_ns ? high : hist->max_ns;
+    }
+  }
+  return hist->max_ns;
+}
+
+double state_machine_hist_mean(const state_machine_hist_t *hist) {
+  assert(hist != NULL);
+  return hist->total_count ? (double)hist->total_ns / (double)hist->total_count : 0.0;
+}
+
+int state_machine_hist_export(const state_machine_hist_t *hist, FILE *file) {
+  assert(hist != NULL);
+  if (!file) {
+    return -1;
+  }
+
+  for (int i = 0; i < STATE_MACHINE_HIST_BUCKETS; i++) {
+    if (hist->counts[i] &&
+        fprintf(file, "%llu %llu %llu\n",
+                (unsigned long long)state_machine_hist_bucket_low(i),
+                (unsigned long long)state_machine_hist_bucket_high(i),
+                (unsigned long long)hist->counts[i]) < 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+state_machine_latency_t *state_machine_latency_create(int per_transition) {
+  state_machine_latency_t *latency = (state_machine_latency_t *)calloc(1, sizeof(state_machine_latency_t));
+  assert(latency != NULL);
+  if (per_transition) {
+    latency->transitions = (state_machine_hist_t *)calloc(
+        STATE_MACHINE_STATE_MAX * MAX_EVENTS_PER_STATE, sizeof(state_machine_hist_t));
+    assert(latency->transitions != NULL);
+  }
+  state_machine_latency_reset(latency);
+  return latency;
+}
+
+void state_machine_latency_destroy(state_machine_latency_t *latency) {
+  assert(latency != NULL);
+  free(latency->transitions);
+  free(latency);
+}
+
+void state_machine_latency_reset(state_machine_latency_t *latency) {
+  assert(latency != NULL);
+  state_machine_hist_reset(&latency->queue_wait);
+  state_machine_hist_reset(&latency->service);
+  state_machine_hist_reset(&latency->end_to_end);
+  if (latency->transitions) {
+    for (int i = 0; i < STATE_MACHINE_STATE_MAX * MAX_EVENTS_PER_STATE; i++) {
+      state_machine_hist_reset(&latency->transitions[i]);
+    }
+  }
+}
+
+void state_machine_latency_merge(state_machine_latency_t *latency, const state_machine_latency_t *other) {
+  assert(latency != NULL);
+  assert(other != NULL);
+  state_machine_hist_merge(&latency->queue_wait, &other->queue_wait);
+  state_machine_hist_merge(&latency->service, &other->service);
+  state_machine_hist_merge(&latency->end_to_end, &other->end_to_end);
+  if (latency->transitions && other->transitions) {
+    for (int i = 0; i < STATE_MACHINE_STATE_MAX * MAX_EVENTS_PER_STATE; i++) {
+      state_machine_hist_merge(&latency->transitions[i], &other->transitions[i]);
+    }
+  }
+}
+
+state_machine_hist_t *state_machine_latency_transition(const state_machine_latency_t *latency, state_id_t state, event_id_t event_id) {
+  assert(latency != NULL);
+  assert(state < STATE_MACHINE_STATE_MAX);
+  assert(event_id < MAX_EVENTS_PER_STATE);
+  if (!latency->transitions) {
+    return NULL;
+  }
+  return &latency->transitions[state * MAX_EVENTS_PER_STATE + event_id];
+}
+
+void state_machine_latency_record(
+    state_machine_latency_t *latency,
+    state_id_t state,
+    event_id_t event_id,
+    uint64_t posted_ns,
+    uint64_t start_ns,
+    uint64_t end_ns) {
+  state_machine_hist_record(&latency->queue_wait, start_ns - posted_ns);
+  state_machine_hist_record(&latency->service, end_ns - start_ns);
+  state_machine_hist_record(&latency->end_to_end, end_ns - posted_ns);
+  if (latency->transitions && event_id < MAX_EVENTS_PER_STATE) {
+    state_machine_hist_record(&latency->transitions[state * MAX_EVENTS_PER_STATE + event_id], end_ns - start_ns);
+  }
+}
@@ -0,0 +1,95 @@
+/**
+ * Copyright (c) 2025 Nicholas Daniell
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef STATE_MACHINE_LATENCY_H
+#define STATE_MACHINE_LATENCY_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "state_machine.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+// Log-linear (HDR style) buckets: values below 2^SUB_BUCKET_BITS are exact, above that every
+// power of two is split into 2^(SUB_BUCKET_BITS - 1) buckets, at most 2^(1 - SUB_BUCKET_BITS)
+// relative error. 6 bits gives 32 buckets per power of two and 3.125%, about 9 KB per histogram.
+#define STATE_MACHINE_HIST_SUB_BUCKET_BITS 6
+// Largest trackable value is 2^MAX_BITS - 1 ns (about 18 minutes), larger values are clamped
+#define STATE_MACHINE_HIST_MAX_BITS 40
+#define STATE_MACHINE_HIST_SUB_BUCKETS (1 << STATE_MACHINE_HIST_SUB_BUCKET_BITS)
+#define STATE_MACHINE_HIST_BUCKETS \
+  (STATE_MACHINE_HIST_SUB_BUCKETS + (STATE_MACHINE_HIST_MAX_BITS - STATE_MACHINE_HIST_SUB_BUCKET_BITS) * (STATE_MACHINE_HIST_SUB_BUCKETS / 2))
+
+typedef struct {
+  uint64_t counts[STATE_MACHINE_HIST_BUCKETS];
+  uint64_t total_count;
+  uint64_t total_ns;
+  uint64_t min_ns;
+  uint64_t max_ns;
+} state_machine_hist_t;
+
+// Latency of events dispatched through one or more queues (an instance group)
+typedef struct {
+  state_machine_hist_t queue_wait;  // post to dispatch start
+  state_machine_hist_t service;     // dispatch start to handler completion
+  state_machine_hist_t end_to_end;  // post to handler completion
+  // Service time by (state, event), NULL unless requested at creation
+  state_machine_hist_t *transitions;
+} state_machine_latency_t;
+
+// Monotonic clock used for every timestamp
+uint64_t state_machine_latency_now(void);
+
+void state_machine_hist_reset(state_machine_hist_t *hist);
+void state_machine_hist_record(state_machine_hist_t *hist, uint64_t value_ns);
+void state_machine_hist_merge(state_machine_hist_t *hist, const state_machine_hist_t *other);
+// Highest value equivalent to the given percentile (0-100), 0 when empty
+uint64_t state_machine_hist_percentile(const state_machine_hist_t *hist, double percentile);
+double state_machine_hist_mean(const state_machine_hist_t *hist);
+// Lowest and highest value that land in bucket index
+uint64_t state_machine_hist_bucket_low(int index);
+uint64_t state_machine_hist_bucket_high(int index);
+// Write the non-empty buckets as "low_ns high_ns count" lines, returns 0 on success, -1 on failure
+int state_machine_hist_export(const state_machine_hist_t *hist, FILE *file);
+
+// per_transition adds STATE_MACHINE_STATE_MAX * MAX_EVENTS_PER_STATE histograms
+state_machine_latency_t *state_machine_latency_create(int per_transition);
+void state_machine_latency_destroy(state_machine_latency_t *latency);
+void state_machine_latency_reset(state_machine_latency_t *latency);
+// Fold other into latency, per transition histograms only if both have them
+void state_machine_latency_merge(state_machine_latency_t *latency, const state_machine_latency_t *other);
+state_machine_hist_t *state_machine_latency_transition(const state_machine_latency_t *latency, state_id_t state, event_id_t event_id);
+void state_machine_latency_record(
+    state_machine_latency_t *latency,
+    state_id_t state,
+    event_id_t event_id,
+    uint64_t posted_ns,
+    uint64_t start_ns,
+    uint64_t end_ns);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif /* STATE_MACHINE_LATENCY_H */
@@ -0,0 +1,216 @@
+/**
+ * Copyright (c) 2025 Nicholas Daniell
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "state_machine_live.h"
+#include <assert.h>
+#include <stdlib.h>
+
+static state_machine_live_version_t *state_machine_live_version_create(
+    state_machine_t *definition,
+    const state_machine_live_version_t *previous,
+    const state_id_t *remap) {
+  state_machine_live_version_t *version = (state_machine_live_version_t *)calloc(1, sizeof(state_machine_live_version_t));
+  assert(version != NULL);
+  version->definition = definition;
+  version->version = previous ? previous->version + 1 : 1;
+
+  int moved = 0;
+  for (int state = 0; state < STATE_MACHINE_STATE_MAX; state++) {
+    version->remap[0][state] = remap ? remap[state] : (state_id_t)state;
+    assert(version->remap[0][state] < STATE_MACHINE_STATE_MAX);
+    moved |= version->remap[0][state] != (state_id_t)state;
+  }
+  version->remapped_version = moved ? version->version : (previous ? previous->remapped_version : 0);
+
+  // Compose with the previous version so lagging instances remap in one lookup
+  for (int k = 1; k < STATE_MACHINE_LIVE_REMAP_HISTORY; k++) {
+    for (int state = 0; state < STATE_MACHINE_STATE_MAX; state++) {
+      state_id_t older = previous ? previous->remap[k - 1][state] : (state_id_t)state;
+      version->remap[k][state] = version->remap[0][older];
+    }
+  }
+  return version;
+}
+
+static void state_machine_live_version_destroy(state_machine_live_version_t *version) {
+  state_machine_destroy(version->definition);
+  free(version);
+}
+
+state_machine_live_t *state_machine_live_create(state_machine_t *definition) {
+  assert(definition != NULL);
+  state_machine_live_t *live = (state_machine_live_t *)calloc(1, sizeof(state_machine_live_t));
+  assert(live != NULL);
+
+  // Epoch 0 marks an idle reader, so counting starts at 1
+  atomic_init(&live->epoch, 1);
+  atomic_init(&live->current, state_machine_live_version_create(definition, NULL, NULL));
+  for (int i = 0; i < STATE_MACHINE_LIVE_READERS_MAX; i++) {
+    atomic_init(&live->readers[i].epoch, 0);
+    atomic_init(&live->readers[i].in_use, 0);
+    live->readers[i].depth = 0;
+  }
+  pthread_mutex_init(&live->publish_lock, NULL);
+  return live;
+}
+
+void state_machine_live_destroy(state_machine_live_t *live) {
+  assert(live != NULL);
+
+  while (live->retired) {
+    state_machine_live_version_t *next = live->retired->next_retired;
+    state_machine_live_version_destroy(live->retired);
+    live->retired = next;
+  }
+  state_machine_live_version_destroy(atomic_load(&live->current));
+  pthread_mutex_destroy(&live->publish_lock);
+  free(live);
+}
+
+int state_machine_live_register_reader(state_machine_live_t *live) {
+  assert(live != NULL);
+  for (int i = 0; i < STATE_MACHINE_LIVE_READERS_MAX; i++) {
+    int expected = 0;
+    if (atomic_compare_exchange_strong(&live->readers[i].in_use, &expected, 1)) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+void state_machine_live_unregister_reader(state_machine_live_t *live, int reader) {
+  assert(live != NULL);
+  assert(reader >= 0 && reader < STATE_MACHINE_LIVE_READERS_MAX);
+  assert(atomic_load(&live->readers[reader].epoch) == 0);
+  assert(live->readers[reader].depth == 0);
+  atomic_store(&live->readers[reader].in_use, 0);
+}
+
+uint32_t state_machine_live_publish(state_machine_live_t *live, state_machine_t *definition, const state_id_t *remap) {
+  assert(live != NULL);
+  assert(definition != NULL);
+
+  pthread_mutex_lock(&live->publish_lock);
+  state_machine_live_version_t *previous = atomic_load(&live->current);
+  state_machine_live_version_t *version = state_machine_live_version_create(definition, previous, remap);
+
+  // Dispatches that announced this epoch or earlier may still hold previous
+  atomic_store(&live->current, version);
+  previous->retire_epoch = atomic_fetch_add(&live->epoch, 1);
+  previous->next_retired = live->retired;
+  live->retired = previous;
+  pthread_mutex_unlock(&live->publish_lock);
+
+  state_machine_live_reclaim(live);
+  return version->version;
+}
+
+uint32_t state_machine_live_reclaim(state_machine_live_t *live) {
+  assert(live != NULL);
+
+  pthread_mutex_lock(&live->publish_lock);
+
+  // Oldest epoch any dispatch in flight may have loaded a version under
+  uint64_t oldest = UINT64_MAX;
+  for (int i = 0; i < STATE_MACHINE_LIVE_READERS_MAX; i++) {
+    uint64_t epoch = atomic_load(&live->readers[i].epoch);
+    if (epoch != 0 && epoch < oldest) {
+      oldest = epoch;
+    }
+  }
+
+  uint32_t pending = 0;
+  state_machine_live_version_t **link = &live->retired;
+  while (*link) {
+    state_machine_live_version_t *version = *link;
+    if (version->retire_epoch < oldest) {
+      *link = version->next_retired;
+      state_machine_live_version_destroy(version);
+    } else {
+      link = &version->next_retired;
+      pending++;
+    }
+  }
+
+  pthread_mutex_unlock(&live->publish_lock);
+  return pending;
+}
+
+uint32_t state_machine_live_version(state_machine_live_t *live) {
+  assert(live != NULL);
+  // The version number is immutable, but the object may be reclaimed once we
+  // stop looking, so read it under the publish lock
+  pthread_mutex_lock(&live->publish_lock);
+  uint32_t version = atomic_load(&live->current)->version;
+  pthread_mutex_unlock(&live->publish_lock);
+  return version;
+}
+
+void state_machine_live_instance_init(state_machine_live_t *live, state_machine_live_instance_t *instance) {
+  assert(live != NULL);
+  assert(instance != NULL);
+  pthread_mutex_lock(&live->publish_lock);
+  state_machine_live_version_t *version = atomic_load(&live->current);
+  instance->current_state = version->definition->initial_state;
+  instance->version = version->version;
+  instance->resets = 0;
+  pthread_mutex_unlock(&live->publish_lock);
+}
+
+int state_machine_live_event(state_machine_live_t *live, int reader, state_machine_live_instance_t *instance, const event_t *event) {
+  assert(live != NULL);
+  assert(reader >= 0 && reader < STATE_MACHINE_LIVE_READERS_MAX);
+  assert(instance != NULL);
+  assert(event != NULL);
+
+  // Announce the epoch before loading the version, both sequentially consistent
+  // so a publisher either sees the announcement or we see its new version.
+  // A nested dispatch from a handler keeps the outer announcement, which is older
+  // than any version it can load and so protects that version as well.
+  state_machine_live_reader_t *slot = &live->readers[reader];
+  assert(atomic_load_explicit(&slot->in_use, memory_order_relaxed));
+  if (slot->depth++ == 0) {
+    assert(atomic_load_explicit(&slot->epoch, memory_order_relaxed) == 0);
+    atomic_store(&slot->epoch, atomic_load(&live->epoch));
+  }
+  const state_machine_live_version_t *version = atomic_load(&live->current);
+
+  // Bring an instance that last ran on an older version into this one's state ids.
+  // Past the remap history its ids are still valid if no publish since moved them,
+  // otherwise it starts over.
+  uint32_t behind = version->version - instance->version;
+  if (behind) {
+    if (behind <= STATE_MACHINE_LIVE_REMAP_HISTORY) {
+      instance->current_state = version->remap[behind - 1][instance->current_state];
+    } else if (instance->version < version->remapped_version) {
+      instance->current_state = version->definition->initial_state;
+      instance->resets++;
+    }
+    instance->version = version->version;
+  }
+
+  int transitioned = state_machine_dispatch_state(version->definition, &instance->current_state, event);
+
+  if (--slot->depth == 0) {
+    atomic_store_explicit(&slot->epoch, 0, memory_order_release);
+  }
+  return transitioned;
+}
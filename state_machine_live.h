@@ -0,0 +1,102 @@
+/**
+ * Copyright (c) 2025 Nicholas Daniell
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef STATE_MACHINE_LIVE_H
+#define STATE_MACHINE_LIVE_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "state_machine.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+#define STATE_MACHINE_LIVE_READERS_MAX 16
+// Instances up to this many versions behind are remapped. Older ones keep their state
+// if every publish since they last ran kept ids unchanged, otherwise they are reset.
+#define STATE_MACHINE_LIVE_REMAP_HISTORY 8
+
+typedef struct state_machine_live_version {
+  state_machine_t *definition;
+  uint32_t version;
+  // remap[k][s] is state s of version (version - 1 - k) expressed in this version
+  state_id_t remap[STATE_MACHINE_LIVE_REMAP_HISTORY][STATE_MACHINE_STATE_MAX];
+  // Latest version published with a remap that moved a state id, 0 if none was
+  uint32_t remapped_version;
+  uint64_t retire_epoch;
+  struct state_machine_live_version *next_retired;
+} state_machine_live_version_t;
+
+// Epoch announced by a dispatching thread, 0 while it is outside a dispatch
+typedef struct {
+  _Alignas(64) _Atomic uint64_t epoch;
+  _Atomic int in_use;
+  // Dispatches in progress on this slot, only touched by the thread that owns it
+  uint32_t depth;
+} state_machine_live_reader_t;
+
+typedef struct {
+  _Atomic(state_machine_live_version_t *) current;
+  _Atomic uint64_t epoch;
+  state_machine_live_reader_t readers[STATE_MACHINE_LIVE_READERS_MAX];
+  // Publishers only, never taken on the dispatch path
+  pthread_mutex_t publish_lock;
+  state_machine_live_version_t *retired;
+} state_machine_live_t;
+
+// An instance dispatched against whatever definition is current
+typedef struct {
+  state_id_t current_state;
+  uint32_t version;
+  // Times the instance fell more than STATE_MACHINE_LIVE_REMAP_HISTORY versions behind
+  // a remap that moved ids and was put back in the initial state of the current definition
+  uint32_t resets;
+} state_machine_live_instance_t;
+
+// Takes ownership of definition, which must not be modified afterwards
+state_machine_live_t *state_machine_live_create(state_machine_t *definition);
+// No dispatch may be in flight
+void state_machine_live_destroy(state_machine_live_t *live);
+
+// Every dispatching thread needs its own reader slot, returns -1 when none are free
+int state_machine_live_register_reader(state_machine_live_t *live);
+void state_machine_live_unregister_reader(state_machine_live_t *live, int reader);
+
+// Atomically replace the definition and take ownership of the new one. remap is indexed by
+// the previous version's state ids, NULL keeps ids unchanged. Returns the new version number.
+uint32_t state_machine_live_publish(state_machine_live_t *live, state_machine_t *definition, const state_id_t *remap);
+// Free retired definitions no dispatch can still see, returns the number still pending
+uint32_t state_machine_live_reclaim(state_machine_live_t *live);
+uint32_t state_machine_live_version(state_machine_live_t *live);
+
+void state_machine_live_instance_init(state_machine_live_t *live, state_machine_live_instance_t *instance);
+// Lock-free, runs to completion on the definition current at entry. Returns 1 on a transition.
+// Handlers may dispatch again on the same reader, the outermost call keeps the epoch announced.
+int state_machine_live_event(state_machine_live_t *live, int reader, state_machine_live_instance_t *instance, const event_t *event);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif /* STATE_MACHINE_LIVE_H */
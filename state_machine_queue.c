@@ -0,0 +1,202 @@
+/**
+ * Copyright (c) 2025 Nicholas Daniell
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "state_machine_queue.h"
+#include <assert.h>
+#include <stdlib.h>
+
+state_machine_queue_t *state_machine_queue_create(void) {
+  state_machine_queue_t *queue = (state_machine_queue_t *)calloc(1, sizeof(state_machine_queue_t));
+  assert(queue != NULL);
+
+  // Chain every slot onto the free list
+  for (int i = 0; i < STATE_MACHINE_QUEUE_SIZE; i++) {
+    queue->entries[i].next = (i + 1 < STATE_MACHINE_QUEUE_SIZE) ? (state_machine_queue_slot_t)(i + 1) : STATE_MACHINE_QUEUE_SLOT_NONE;
+  }
+  queue->free_head = 0;
+
+  for (int i = 0; i < STATE_MACHINE_QUEUE_PRIORITY_MAX; i++) {
+    queue->lanes[i].head = STATE_MACHINE_QUEUE_SLOT_NONE;
+    queue->lanes[i].tail = STATE_MACHINE_QUEUE_SLOT_NONE;
+  }
+
+  // Unconfigured events go to the lowest priority lane without coalescing
+  for (int i = 0; i < MAX_EVENTS_PER_STATE; i++) {
+    queue->pending[i] = STATE_MACHINE_QUEUE_SLOT_NONE;
+    queue->event_priority[i] = STATE_MACHINE_QUEUE_PRIORITY_LOW;
+  }
+  return queue;
+}
+
+void state_machine_queue_destroy(state_machine_queue_t *queue) {
+  assert(queue != NULL);
+  if (queue->release) {
+    event_t event;
+    while (state_machine_queue_pop(queue, &event)) {
+      queue->release(&event, queue->release_context);
+    }
+  }
+  free(queue);
+}
+
+void state_machine_queue_configure_event(
+    state_machine_queue_t *queue,
+    event_id_t event_id,
+    uint8_t priority,
+    int coalesce) {
+  assert(queue != NULL);
+  assert(event_id < MAX_EVENTS_PER_STATE);
+  assert(priority < STATE_MACHINE_QUEUE_PRIORITY_MAX);
+  // Moving an id between lanes while one is pending would strand its index
+  assert(queue->pending[event_id] == STATE_MACHINE_QUEUE_SLOT_NONE);
+
+  queue->event_priority[event_id] = priority;
+  queue->event_coalesce[event_id] = coalesce ? 1 : 0;
+}
+
+int state_machine_queue_post(state_machine_queue_t *queue, event_t event) {
+  assert(queue != NULL);
+  assert(event.event_id < MAX_EVENTS_PER_STATE);
+
+  // Replace the pending event in place, it keeps its position in the lane
+  state_machine_queue_slot_t slot = queue->pending[event.event_id];
+  if (slot != STATE_MACHINE_QUEUE_SLOT_NONE) {
+    if (queue->release) {
+      queue->release(&queue->entries[slot].event, queue->release_context);
+    }
+    queue->entries[slot].event = event;
+    queue->coalesced++;
+    return 0;
+  }
+
+  slot = queue->free_head;
+  if (slot == STATE_MACHINE_QUEUE_SLOT_NONE) {
+    return -1;
+  }
+  queue->free_head = queue->entries[slot].next;
+
+  state_machine_queue_entry_t *entry = &queue->entries[slot];
+  entry->event = event;
+  entry->next = STATE_MACHINE_QUEUE_SLOT_NONE;
+  if (queue->latency) {
+    entry->posted_ns = state_machine_latency_now();
+  }
+
+  state_machine_queue_lane_t *lane = &queue->lanes[queue->event_priority[event.event_id]];
+  if (lane->tail == STATE_MACHINE_QUEUE_SLOT_NONE) {
+    lane->head = slot;
+  } else {
+    queue->entries[lane->tail].next = slot;
+  }
+  lane->tail = slot;
+
+  if (queue->event_coalesce[event.event_id]) {
+    queue->pending[event.event_id] = slot;
+  }
+  queue->count++;
+  return 0;
+}
+
+static int state_machine_queue_take(state_machine_queue_t *queue, event_t *event, uint64_t *posted_ns) {
+  for (int i = 0; i < STATE_MACHINE_QUEUE_PRIORITY_MAX; i++) {
+    state_machine_queue_lane_t *lane = &queue->lanes[i];
+    state_machine_queue_slot_t slot = lane->head;
+    if (slot == STATE_MACHINE_QUEUE_SLOT_NONE) {
+      continue;
+    }
+
+    state_machine_queue_entry_t *entry = &queue->entries[slot];
+    lane->head = entry->next;
+    if (lane->head == STATE_MACHINE_QUEUE_SLOT_NONE) {
+      lane->tail = STATE_MACHINE_QUEUE_SLOT_NONE;
+    }
+
+    *event = entry->event;
+    *posted_ns = entry->posted_ns;
+    if (queue->pending[event->event_id] == slot) {
+      queue->pending[event->event_id] = STATE_MACHINE_QUEUE_SLOT_NONE;
+    }
+
+    entry->next = queue->free_head;
+    queue->free_head = slot;
+    queue->count--;
+    return 1;
+  }
+  return 0;
+}
+
+int state_machine_queue_pop(state_machine_queue_t *queue, event_t *event) {
+  assert(queue != NULL);
+  assert(event != NULL);
+  uint64_t posted_ns;
+  return state_machine_queue_take(queue, event, &posted_ns);
+}
+
+int state_machine_queue_pop_stamped(state_machine_queue_t *queue, event_t *event, uint64_t *posted_ns) {
+  assert(queue != NULL);
+  assert(event != NULL);
+  assert(posted_ns != NULL);
+  return state_machine_queue_take(queue, event, posted_ns);
+}
+
+uint32_t state_machine_queue_dispatch(state_machine_queue_t *queue, state_machine_t *state_machine) {
+  assert(queue != NULL);
+  assert(state_machine != NULL);
+
+  // Handlers may post while we drain, those events are dispatched too
+  uint32_t dispatched = 0;
+  event_t event;
+  uint64_t posted_ns;
+  while (state_machine_queue_take(queue, &event, &posted_ns)) {
+    state_machine_latency_t *latency = queue->latency;
+    if (latency) {
+      state_id_t state = state_machine->current_state;
+      uint64_t start_ns = state_machine_latency_now();
+      state_machine_dispatch(state_machine, &event);
+      state_machine_latency_record(latency, state, event.event_id, posted_ns, start_ns, state_machine_latency_now());
+    } else {
+      state_machine_dispatch(state_machine, &event);
+    }
+    dispatched++;
+  }
+  return dispatched;
+}
+
+uint32_t state_machine_queue_count(const state_machine_queue_t *queue) {
+  assert(queue != NULL);
+  return queue->count;
+}
+
+void state_machine_queue_set_release(
+    state_machine_queue_t *queue,
+    state_machine_queue_release_t release,
+    void *context) {
+  assert(queue != NULL);
+  queue->release = release;
+  queue->release_context = context;
+}
+
+void state_machine_queue_set_latency(state_machine_queue_t *queue, state_machine_latency_t *latency) {
+  assert(queue != NULL);
+  // Events already pending carry no post time
+  assert(queue->count == 0);
+  queue->latency = latency;
+}
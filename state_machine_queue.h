@@ -0,0 +1,116 @@
+/**
+ * Copyright (c) 2025 Nicholas Daniell
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef STATE_MACHINE_QUEUE_H
+#define STATE_MACHINE_QUEUE_H
+
+#include <stdint.h>
+
+#include "state_machine.h"
+#include "state_machine_latency.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+#define STATE_MACHINE_QUEUE_SIZE 32
+#define STATE_MACHINE_QUEUE_PRIORITY_MAX 4
+
+// Lane 0 is the most urgent, lanes are drained in strict order
+#define STATE_MACHINE_QUEUE_PRIORITY_HIGH 0
+#define STATE_MACHINE_QUEUE_PRIORITY_LOW (STATE_MACHINE_QUEUE_PRIORITY_MAX - 1)
+
+typedef uint16_t state_machine_queue_slot_t;
+#define STATE_MACHINE_QUEUE_SLOT_NONE ((state_machine_queue_slot_t)0xFFFF)
+
+typedef struct {
+  event_t event;
+  state_machine_queue_slot_t next;
+  uint64_t posted_ns;  // only stamped while latency tracking is on
+} state_machine_queue_entry_t;
+
+typedef struct {
+  state_machine_queue_slot_t head;
+  state_machine_queue_slot_t tail;
+} state_machine_queue_lane_t;
+
+// Receives an event the queue drops without dispatching, so its payload can be freed
+typedef void (*state_machine_queue_release_t)(event_t *event, void *context);
+
+typedef struct {
+  state_machine_queue_entry_t entries[STATE_MACHINE_QUEUE_SIZE];
+  state_machine_queue_lane_t lanes[STATE_MACHINE_QUEUE_PRIORITY_MAX];
+  state_machine_queue_slot_t free_head;
+  // Slot holding the pending event for each coalesced event id
+  state_machine_queue_slot_t pending[MAX_EVENTS_PER_STATE];
+  uint8_t event_priority[MAX_EVENTS_PER_STATE];
+  uint8_t event_coalesce[MAX_EVENTS_PER_STATE];
+  uint32_t count;
+  uint32_t coalesced;
+  state_machine_latency_t *latency;
+  state_machine_queue_release_t release;
+  void *release_context;
+} state_machine_queue_t;
+
+state_machine_queue_t *state_machine_queue_create(void);
+void state_machine_queue_destroy(state_machine_queue_t *queue);
+
+// Select the lane an event id is posted to and whether a newer pending
+// event with the same id replaces the older one instead of queueing behind it
+void state_machine_queue_configure_event(
+    state_machine_queue_t *queue,
+    event_id_t event_id,
+    uint8_t priority,
+    int coalesce);
+
+// Returns 0 on success (including when coalesced), -1 if the queue is full.
+// event_data stays owned by the caller until the event is popped or dispatched,
+// a coalesced event is handed to the release callback instead.
+int state_machine_queue_post(state_machine_queue_t *queue, event_t event);
+
+// Returns 1 and fills event if one was pending, 0 if the queue is empty
+int state_machine_queue_pop(state_machine_queue_t *queue, event_t *event);
+// As above, also returns the post time for callers that record latency themselves,
+// only meaningful while latency tracking is on
+int state_machine_queue_pop_stamped(state_machine_queue_t *queue, event_t *event, uint64_t *posted_ns);
+
+// Feed every pending event to the state machine, returns the number dispatched
+uint32_t state_machine_queue_dispatch(state_machine_queue_t *queue, state_machine_t *state_machine);
+
+uint32_t state_machine_queue_count(const state_machine_queue_t *queue);
+
+// Called for the event a coalescing post replaces and for events still pending
+// at destroy, NULL (the default) drops them silently
+void state_machine_queue_set_release(
+    state_machine_queue_t *queue,
+    state_machine_queue_release_t release,
+    void *context);
+
+// Timestamp posts and record wait and service times of dispatched events into latency,
+// NULL turns tracking off. Several queues may share one tracker from a single thread.
+// A coalesced event keeps the post time of the event it replaced.
+void state_machine_queue_set_latency(state_machine_queue_t *queue, state_machine_latency_t *latency);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif /* STATE_MACHINE_QUEUE_H */
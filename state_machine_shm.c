@@ -0,0 +1,220 @@
+/**
+ * Copyright (c) 2025 Nicholas Daniell
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include "state_machine_shm.h"
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static size_t state_machine_shm_size(uint32_t capacity) {
+  return sizeof(state_machine_shm_header_t) + (size_t)capacity * sizeof(state_machine_shm_entry_t);
+}
+
+static state_machine_shm_t *state_machine_shm_alloc(const char *name, void *mapping, size_t size, int owner) {
+  state_machine_shm_t *shm = (state_machine_shm_t *)calloc(1, sizeof(state_machine_shm_t));
+  assert(shm != NULL);
+  shm->header = (state_machine_shm_header_t *)mapping;
+  shm->size = size;
+  shm->owner = owner;
+  snprintf(shm->name, sizeof(shm->name), "%s", name);
+  return shm;
+}
+
+state_machine_shm_t *state_machine_shm_create(const char *name, uint32_t capacity) {
+  assert(name != NULL);
+  assert(capacity > 0);
+
+  // Never take over a segment another process may still be writing or mapping
+  int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+  if (fd < 0) {
+    return NULL;
+  }
+
+  size_t size = state_machine_shm_size(capacity);
+  if (ftruncate(fd, (off_t)size) != 0) {
+    close(fd);
+    shm_unlink(name);
+    return NULL;
+  }
+
+  void *mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    shm_unlink(name);
+    return NULL;
+  }
+
+  // ftruncate zero fills, so every entry starts unused with an even sequence
+  state_machine_shm_header_t *header = (state_machine_shm_header_t *)mapping;
+  header->version = STATE_MACHINE_SHM_VERSION;
+  header->capacity = capacity;
+  header->entry_size = sizeof(state_machine_shm_entry_t);
+  // Readers check the magic last
+  atomic_thread_fence(memory_order_release);
+  header->magic = STATE_MACHINE_SHM_MAGIC;
+
+  return state_machine_shm_alloc(name, mapping, size, 1);
+}
+
+int state_machine_shm_unlink(const char *name) {
+  assert(name != NULL);
+  return shm_unlink(name) == 0 ? 0 : -1;
+}
+
+state_machine_shm_t *state_machine_shm_open(const char *name) {
+  assert(name != NULL);
+
+  int fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0) {
+    return NULL;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(state_machine_shm_header_t)) {
+    close(fd);
+    return NULL;
+  }
+
+  size_t size = (size_t)st.st_size;
+  void *mapping = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    return NULL;
+  }
+
+  const state_machine_shm_header_t *header = (const state_machine_shm_header_t *)mapping;
+  if (header->magic != STATE_MACHINE_SHM_MAGIC ||
+      header->version != STATE_MACHINE_SHM_VERSION ||
+      header->entry_size != sizeof(state_machine_shm_entry_t) ||
+      state_machine_shm_size(header->capacity) > size) {
+    munmap(mapping, size);
+    return NULL;
+  }
+
+  return state_machine_shm_alloc(name, mapping, size, 0);
+}
+
+void state_machine_shm_close(state_machine_shm_t *shm) {
+  assert(shm != NULL);
+  munmap(shm->header, shm->size);
+  if (shm->owner) {
+    shm_unlink(shm->name);
+  }
+  free(shm);
+}
+
+uint32_t state_machine_shm_capacity(const state_machine_shm_t *shm) {
+  assert(shm != NULL);
+  return shm->header->capacity;
+}
+
+state_machine_shm_entry_t *state_machine_shm_entry(const state_machine_shm_t *shm, uint32_t index) {
+  assert(shm != NULL);
+  assert(index < shm->header->capacity);
+  return &shm->header->entries[index];
+}
+
+static inline void state_machine_shm_write_begin(state_machine_shm_entry_t *entry) {
+  uint32_t sequence = atomic_load_explicit(&entry->sequence, memory_order_relaxed);
+  atomic_store_explicit(&entry->sequence, sequence + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+}
+
+static inline void state_machine_shm_write_end(state_machine_shm_entry_t *entry) {
+  uint32_t sequence = atomic_load_explicit(&entry->sequence, memory_order_relaxed);
+  atomic_store_explicit(&entry->sequence, sequence + 1, memory_order_release);
+}
+
+static void state_machine_shm_release(state_machine_shm_entry_t *entry) {
+  // Monitors stop listing the instance
+  state_machine_shm_write_begin(entry);
+  atomic_store_explicit(&entry->in_use, 0, memory_order_relaxed);
+  state_machine_shm_write_end(entry);
+}
+
+static void state_machine_shm_observer(state_machine_t *state_machine, int notification, void *context) {
+  state_machine_shm_entry_t *entry = (state_machine_shm_entry_t *)context;
+  if (notification == STATE_MACHINE_NOTIFY_DESTROY) {
+    state_machine_shm_release(entry);
+    return;
+  }
+  state_machine_shm_publish(entry, state_machine->current_state, notification == STATE_MACHINE_NOTIFY_TRANSITION);
+}
+
+void state_machine_attach_shm(state_machine_t *state_machine, state_machine_shm_entry_t *entry) {
+  assert(state_machine != NULL);
+
+  state_machine_shm_entry_t *previous =
+      (state_machine_shm_entry_t *)state_machine_observer_context(state_machine, state_machine_shm_observer);
+  if (previous) {
+    state_machine_shm_release(previous);
+    state_machine_remove_observer(state_machine, state_machine_shm_observer, previous);
+  }
+
+  if (entry) {
+    state_machine_shm_write_begin(entry);
+    atomic_store_explicit(&entry->in_use, 1, memory_order_relaxed);
+    atomic_store_explicit(&entry->current_state, state_machine->current_state, memory_order_relaxed);
+    atomic_store_explicit(&entry->events_processed, 0, memory_order_relaxed);
+    atomic_store_explicit(&entry->transitions, 0, memory_order_relaxed);
+    state_machine_shm_write_end(entry);
+    int attached = state_machine_add_observer(state_machine, state_machine_shm_observer, entry);
+    assert(attached == 0);
+    (void)attached;
+  }
+}
+
+void state_machine_shm_publish(state_machine_shm_entry_t *entry, state_id_t current_state, int transitioned) {
+  // Single writer, so plain read-modify-write of the counters is safe
+  uint64_t events = atomic_load_explicit(&entry->events_processed, memory_order_relaxed);
+  uint64_t transitions = atomic_load_explicit(&entry->transitions, memory_order_relaxed);
+
+  state_machine_shm_write_begin(entry);
+  atomic_store_explicit(&entry->current_state, current_state, memory_order_relaxed);
+  atomic_store_explicit(&entry->events_processed, events + 1, memory_order_relaxed);
+  atomic_store_explicit(&entry->transitions, transitions + (transitioned ? 1 : 0), memory_order_relaxed);
+  state_machine_shm_write_end(entry);
+}
+
+void state_machine_shm_snapshot(const state_machine_shm_entry_t *entry, state_machine_shm_snapshot_t *snapshot) {
+  assert(entry != NULL);
+  assert(snapshot != NULL);
+
+  // Casts drop const only for the C11 atomic load signatures, nothing is written
+  state_machine_shm_entry_t *shared = (state_machine_shm_entry_t *)entry;
+  uint32_t begin;
+  uint32_t end;
+  do {
+    begin = atomic_load_explicit(&shared->sequence, memory_order_acquire);
+    snapshot->in_use = atomic_load_explicit(&shared->in_use, memory_order_relaxed);
+    snapshot->current_state = (state_id_t)atomic_load_explicit(&shared->current_state, memory_order_relaxed);
+    snapshot->events_processed = atomic_load_explicit(&shared->events_processed, memory_order_relaxed);
+    snapshot->transitions = atomic_load_explicit(&shared->transitions, memory_order_relaxed);
+    atomic_thread_fence(memory_order_acquire);
+    end = atomic_load_explicit(&shared->sequence, memory_order_relaxed);
+  } while ((begin & 1) || begin != end);
+}
@@ -0,0 +1,102 @@
+/**
+ * Copyright (c) 2025 Nicholas Daniell
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef STATE_MACHINE_SHM_H
+#define STATE_MACHINE_SHM_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "state_machine.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+// Entries are shared across processes and mapped read-only by monitors, which only
+// works if the atomics are plain lock-free words rather than guarded by per-process locks
+_Static_assert(ATOMIC_INT_LOCK_FREE == 2, "32-bit atomics must be lock-free for shared memory");
+_Static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "64-bit atomics must be lock-free for shared memory");
+
+#define STATE_MACHINE_SHM_MAGIC 0x45534D31u  // "ESM1"
+#define STATE_MACHINE_SHM_VERSION 1
+
+// One published instance, written only by the dispatching thread. The
+// sequence is odd while an update is in progress (seqlock).
+struct state_machine_shm_entry {
+  _Atomic uint32_t sequence;
+  _Atomic uint32_t in_use;
+  _Atomic uint32_t current_state;
+  _Atomic uint64_t events_processed;
+  _Atomic uint64_t transitions;
+};
+typedef struct state_machine_shm_entry state_machine_shm_entry_t;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t capacity;
+  uint32_t entry_size;
+  state_machine_shm_entry_t entries[];
+} state_machine_shm_header_t;
+
+typedef struct {
+  state_machine_shm_header_t *header;
+  size_t size;
+  int owner;
+  char name[64];
+} state_machine_shm_t;
+
+typedef struct {
+  uint32_t in_use;
+  state_id_t current_state;
+  uint64_t events_processed;
+  uint64_t transitions;
+} state_machine_shm_snapshot_t;
+
+// Create (and own) a POSIX shared memory segment with room for capacity instances,
+// returns NULL on failure, including when name already exists. The segment is
+// unlinked again when the owner closes it.
+state_machine_shm_t *state_machine_shm_create(const char *name, uint32_t capacity);
+// Remove a segment left behind by an owner that exited without closing it.
+// Returns 0 on success, -1 if there was nothing to remove.
+int state_machine_shm_unlink(const char *name);
+// Map an existing segment read-only, returns NULL if it is missing or not an ESM segment
+state_machine_shm_t *state_machine_shm_open(const char *name);
+void state_machine_shm_close(state_machine_shm_t *shm);
+
+uint32_t state_machine_shm_capacity(const state_machine_shm_t *shm);
+state_machine_shm_entry_t *state_machine_shm_entry(const state_machine_shm_t *shm, uint32_t index);
+
+// Publish the machine's state and counters to entry on every dispatch, NULL detaches.
+// state_machine_destroy() detaches too, so the entry is marked unused.
+void state_machine_attach_shm(state_machine_t *state_machine, state_machine_shm_entry_t *entry);
+void state_machine_shm_publish(state_machine_shm_entry_t *entry, state_id_t current_state, int transitioned);
+
+// Consistent copy of an entry, retries while the writer is mid-update but never stalls it
+void state_machine_shm_snapshot(const state_machine_shm_entry_t *entry, state_machine_shm_snapshot_t *snapshot);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif /* STATE_MACHINE_SHM_H */
@@ -0,0 +1,92 @@
+/**
+ * Copyright (c) 2025 Nicholas Daniell
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "state_machine_shm.h"
+
+static void print_usage(const char *program) {
+  fprintf(stderr, "Usage: %s [-a] [-w interval_ms] <segment name>\n", program);
+  fprintf(stderr, "  -a  also list unused entries\n");
+  fprintf(stderr, "  -w  keep dumping every interval_ms milliseconds\n");
+}
+
+static void dump_segment(const state_machine_shm_t *shm, int show_all) {
+  printf("%-8s %-8s %-20s %-20s\n", "index", "state", "events", "transitions");
+  for (uint32_t i = 0; i < state_machine_shm_capacity(shm); i++) {
+    state_machine_shm_snapshot_t snapshot;
+    state_machine_shm_snapshot(state_machine_shm_entry(shm, i), &snapshot);
+    if (!snapshot.in_use && !show_all) {
+      continue;
+    }
+    printf("%-8u %-8u %-20llu %-20llu%s\n",
+           i,
+           snapshot.current_state,
+           (unsigned long long)snapshot.events_processed,
+           (unsigned long long)snapshot.transitions,
+           snapshot.in_use ? "" : " (unused)");
+  }
+}
+
+int main(int argc, char **argv) {
+  int show_all = 0;
+  long interval_ms = 0;
+  int opt;
+  while ((opt = getopt(argc, argv, "aw:")) != -1) {
+    switch (opt) {
+    case 'a':
+      show_all = 1;
+      break;
+    case 'w':
+      interval_ms = strtol(optarg, NULL, 10);
+      break;
+    default:
+      print_usage(argv[0]);
+      return 2;
+    }
+  }
+  if (optind != argc - 1 || interval_ms < 0) {
+    print_usage(argv[0]);
+    return 2;
+  }
+
+  state_machine_shm_t *shm = state_machine_shm_open(argv[optind]);
+  if (!shm) {
+    fprintf(stderr, "%s: cannot open ESM segment %s\n", argv[0], argv[optind]);
+    return 1;
+  }
+
+  do {
+    dump_segment(shm, show_all);
+    if (interval_ms) {
+      printf("\n");
+      fflush(stdout);
+      struct timespec interval = {interval_ms / 1000, (interval_ms % 1000) * 1000000L};
+      nanosleep(&interval, NULL);
+    }
+  } while (interval_ms);
+
+  state_machine_shm_close(shm);
+  return 0;
+}
@@ -63,7 +63,7 @@ char* state_machine_generate_dot(state_machine_t* state_machine) {
                 "    %s [%s%s];\n",
                 state_name,
                 i == state_machine->current_state ? "style=filled,fillcolor=lightblue" : "",
-                state_machine->state_table[i].state_on_enter || state_machine->state_table[i].state_on_exit ? 
+                state_machine->state_table[i].state_on_enter.action || state_machine->state_table[i].state_on_exit.action ?
                     ",penwidth=2" : "");
         }
     }
@@ -83,7 +83,7 @@ char* state_machine_generate_dot(state_machine_t* state_machine) {
                     from_state,
                     to_state,
                     transition->event_id,
-                    transition->on_transition ? "*" : "");
+                    transition->on_transition.action ? "*" : "");
             }
         }
     }
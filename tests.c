@@ -23,8 +23,20 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <sys/epoll.h>
 #include "state_machine.h"
 #include "state_machine_viz.h"
+#include "state_machine_queue.h"
+#include "state_machine_shm.h"
+#include "state_machine_live.h"
+#include "state_machine_latency.h"
+#include "state_machine_group.h"
+#include "state_machine_dispatcher.h"
 
 typedef enum {
     TEST_EVENT_ID_RESET = 0,
@@ -45,12 +57,21 @@ static event_t error_event = {TEST_EVENT_ID_ERROR, 0, NULL};
 #define PERF_NUM_TRANSITIONS 5
 #define PERF_WARMUP_ITERATIONS 1000
 
+#define SHM_NUM_EVENTS 200000
+#define LIVE_NUM_PUBLISHES 200
+#define GROUP_NUM_INSTANCES 100
+#define DISPATCHER_NUM_PRODUCERS 2
+#define DISPATCHER_NUM_EVENTS 20000
+
 #define DEBUG_STATE_MACHINE 0
 
 typedef struct {
     double avg_event_processing_us;
     double min_event_processing_us;
     double max_event_processing_us;
+    double p50_event_processing_us;
+    double p99_event_processing_us;
+    double p999_event_processing_us;
     uint64_t total_state_changes;
     uint64_t total_events_processed;
 } perf_stats_t;
@@ -119,6 +140,54 @@ void on_transition_handler(event_t event) {
     #endif
 }
 
+void state_on_enter_action(const event_t* event, void* context) {
+    #if DEBUG_STATE_MACHINE
+        printf("State on enter action\n");
+    #endif
+}
+
+void state_on_exit_action(const event_t* event, void* context) {
+    #if DEBUG_STATE_MACHINE
+        printf("State on exit action\n");
+    #endif
+}
+
+// Records the order handlers ran in through the instance context
+typedef struct {
+    char trace[16];
+    int length;
+    state_machine_t* state_machine;
+    state_id_t state_seen_on_exit;
+    state_id_t state_seen_on_enter;
+} action_trace_t;
+
+static action_trace_t* legacy_trace;
+
+static void trace_exit_action(const event_t* event, void* context) {
+    action_trace_t* trace = (action_trace_t*)context;
+    trace->trace[trace->length++] = 'x';
+    trace->state_seen_on_exit = trace->state_machine->current_state;
+}
+
+static void trace_transition_action(const event_t* event, void* context) {
+    action_trace_t* trace = (action_trace_t*)context;
+    trace->trace[trace->length++] = 't';
+}
+
+static void trace_enter_action(const event_t* event, void* context) {
+    action_trace_t* trace = (action_trace_t*)context;
+    trace->trace[trace->length++] = 'n';
+    trace->state_seen_on_enter = trace->state_machine->current_state;
+}
+
+static void trace_legacy_enter_handler(event_t event) {
+    legacy_trace->trace[legacy_trace->length++] = 'N';
+}
+
+static int trace_guard_action(const event_t* event, void* context) {
+    return event->event_data != NULL && *(int*)event->event_data == 42;
+}
+
 int simple_walk_test(void) {
     state_machine_t* state_machine = state_machine_create(STATE_MACHINE_STATE_INIT);
 
@@ -190,6 +259,7 @@ void visualization_test(void) {
 
     // Cleanup generated files
     printf("Cleaning up test files...\n");
+    cleanup_test_files("state_machine.dot");
     cleanup_test_files("state_machine_*.dot");
     cleanup_test_files("state_machine_*.png");
     printf("[DONE] Cleaned up visualization files\n");
@@ -298,18 +368,22 @@ void print_structure_statistics(void) {
     printf("State Table Entry:\n");
     printf("  state_table_entry_t total size: %zu bytes\n", sizeof(state_table_entry_t));
     printf("    - state:           %zu bytes\n", sizeof(state_id_t));
-    printf("    - state_on_enter:  %zu bytes\n", sizeof(state_machine_event_handler_t));
-    printf("    - state_on_exit:   %zu bytes\n", sizeof(state_machine_event_handler_t));
+    printf("    - flags:           %zu bytes\n", sizeof(uint8_t));
+    printf("    - state_on_enter:  %zu bytes\n", sizeof(state_machine_handler_t));
+    printf("    - state_on_exit:   %zu bytes\n", sizeof(state_machine_handler_t));
+    printf("    - contexts:        %zu bytes\n", sizeof(void*) * 2);
     printf("\n");
 
     // Transition structure
     printf("Transition Structure:\n");
     printf("  state_machine_transition_t total size: %zu bytes\n", sizeof(state_machine_transition_t));
-    printf("    - init:            %zu bytes\n", sizeof(int));
+    printf("    - init, flags:     %zu bytes\n", sizeof(uint8_t) * 2);
     printf("    - current_state:   %zu bytes\n", sizeof(state_id_t));
     printf("    - next_state:      %zu bytes\n", sizeof(state_id_t));
     printf("    - event_id:        %zu bytes\n", sizeof(event_id_t));
-    printf("    - on_transition:   %zu bytes\n", sizeof(state_machine_event_handler_t));
+    printf("    - on_transition:   %zu bytes\n", sizeof(state_machine_handler_t));
+    printf("    - guard:           %zu bytes\n", sizeof(state_machine_guard_slot_t));
+    printf("    - contexts:        %zu bytes\n", sizeof(void*) * 2);
     printf("\n");
 
     // Main state machine structure
@@ -318,8 +392,15 @@ void print_structure_statistics(void) {
     printf("    - state_table:     %zu bytes\n", sizeof(state_table_entry_t[STATE_MACHINE_STATE_MAX]));
     printf("    - initial_state:   %zu bytes\n", sizeof(state_id_t));
     printf("    - current_state:   %zu bytes\n", sizeof(state_id_t));
+    printf("    - context:         %zu bytes\n", sizeof(void*));
+    printf("    - observers:       %zu bytes\n",
+           sizeof(state_machine_observer_entry_t[STATE_MACHINE_OBSERVERS_MAX]) + sizeof(uint32_t));
+    printf("    - group links:     %zu bytes\n", sizeof(void*) * 3 + sizeof(state_id_t) + sizeof(uint32_t));
     printf("    - state_transitions: %zu bytes\n", 
            sizeof(state_machine_transition_t[STATE_MACHINE_STATE_MAX][MAX_EVENTS_PER_STATE]));
+    printf("    - accepted_events: %zu bytes\n", sizeof(state_machine_event_mask_t[STATE_MACHINE_STATE_MAX]));
+    printf("    - reachable_states: %zu bytes\n", sizeof(state_machine_state_mask_t[STATE_MACHINE_STATE_MAX]));
+    printf("    - handler_kinds:   %zu bytes\n", sizeof(uint8_t));
     printf("\n");
 
     // Configuration constants
@@ -335,22 +416,21 @@ void print_structure_statistics(void) {
            sizeof(state_machine_t) - (
                sizeof(state_table_entry_t[STATE_MACHINE_STATE_MAX]) +
                sizeof(state_id_t) * 2 +
-               sizeof(state_machine_transition_t[STATE_MACHINE_STATE_MAX][MAX_EVENTS_PER_STATE])
+               sizeof(void*) * 4 +
+               sizeof(state_machine_observer_entry_t[STATE_MACHINE_OBSERVERS_MAX]) + sizeof(uint32_t) +
+               sizeof(state_id_t) + sizeof(uint32_t) +
+               sizeof(state_machine_transition_t[STATE_MACHINE_STATE_MAX][MAX_EVENTS_PER_STATE]) +
+               sizeof(state_machine_event_mask_t[STATE_MACHINE_STATE_MAX]) +
+               sizeof(state_machine_state_mask_t[STATE_MACHINE_STATE_MAX]) +
+               sizeof(uint8_t)
            ));
     printf("\n");
 }
 
-static double get_time_us(void) {
-    struct timespec ts;
-    clock_gettime(CLOCK_MONOTONIC, &ts);
-    return (double)ts.tv_sec * 1e6 + (double)ts.tv_nsec / 1e3;
-}
-
 static perf_stats_t run_performance_test(state_machine_t* state_machine, event_t* events, int num_events) {
     perf_stats_t stats = {0};
-    double min_time = 1e9;  // Initialize to a large value
-    double max_time = 0;
-    double total_time = 0;
+    state_machine_hist_t hist;
+    state_machine_hist_reset(&hist);
     
     // Warm up to avoid cold cache effects
     for (int i = 0; i < PERF_WARMUP_ITERATIONS; i++) {
@@ -362,14 +442,11 @@ static perf_stats_t run_performance_test(state_machine_t* state_machine, event_t
         state_id_t prev_state = state_machine->current_state;
         event_t current_event = events[i % num_events];
         
-        double start_time = get_time_us();
+        uint64_t start_time = state_machine_latency_now();
         state_machine_event(state_machine, current_event);
-        double end_time = get_time_us();
+        uint64_t end_time = state_machine_latency_now();
         
-        double elapsed = end_time - start_time;
-        total_time += elapsed;
-        min_time = (elapsed < min_time) ? elapsed : min_time;
-        max_time = (elapsed > max_time) ? elapsed : max_time;
+        state_machine_hist_record(&hist, end_time - start_time);
         
         stats.total_events_processed++;
         if (prev_state != state_machine->current_state) {
@@ -377,9 +454,12 @@ static perf_stats_t run_performance_test(state_machine_t* state_machine, event_t
         }
     }
     
-    stats.avg_event_processing_us = total_time / PERF_NUM_ITERATIONS;
-    stats.min_event_processing_us = min_time;
-    stats.max_event_processing_us = max_time;
+    stats.avg_event_processing_us = state_machine_hist_mean(&hist) / 1e3;
+    stats.min_event_processing_us = hist.min_ns / 1e3;
+    stats.max_event_processing_us = hist.max_ns / 1e3;
+    stats.p50_event_processing_us = state_machine_hist_percentile(&hist, 50.0) / 1e3;
+    stats.p99_event_processing_us = state_machine_hist_percentile(&hist, 99.0) / 1e3;
+    stats.p999_event_processing_us = state_machine_hist_percentile(&hist, 99.9) / 1e3;
     
     return stats;
 }
@@ -417,6 +497,8 @@ void performance_test(void) {
     printf("  Average event processing time: %.3f us\n", stats.avg_event_processing_us);
     printf("  Minimum event processing time: %.3f us\n", stats.min_event_processing_us);
     printf("  Maximum event processing time: %.3f us\n", stats.max_event_processing_us);
+    printf("  p50 / p99 / p99.9 event processing time: %.3f / %.3f / %.3f us\n",
+           stats.p50_event_processing_us, stats.p99_event_processing_us, stats.p999_event_processing_us);
     printf("  Events per second: %.2f\n", 1e6 / stats.avg_event_processing_us);
     printf("  Total state changes: %lu\n", stats.total_state_changes);
     printf("  State change ratio: %.2f%%\n", 
@@ -434,6 +516,18 @@ void performance_test(void) {
     printf("  Average event processing time: %.3f us\n", stats_with_handlers.avg_event_processing_us);
     printf("  Handler overhead: %.3f us\n", 
            stats_with_handlers.avg_event_processing_us - stats.avg_event_processing_us);
+
+    printf("\nRunning test with pointer-passing action handlers:\n");
+    for (int i = 0; i < PERF_NUM_TRANSITIONS; i++) {
+        state_machine_assign_on_enter_action(state_machine, i, state_on_enter_action);
+        state_machine_assign_on_exit_action(state_machine, i, state_on_exit_action);
+    }
+
+    perf_stats_t stats_with_actions = run_performance_test(state_machine, test_events, PERF_NUM_TRANSITIONS);
+
+    printf("  Average event processing time: %.3f us\n", stats_with_actions.avg_event_processing_us);
+    printf("  Handler overhead: %.3f us\n",
+           stats_with_actions.avg_event_processing_us - stats.avg_event_processing_us);
     
     state_machine_destroy(state_machine);
 }
@@ -494,6 +588,773 @@ int guard_condition_test(void) {
     return 0;
 }
 
+// Counts payloads the queue gave back without dispatching
+static void count_released_event(event_t* event, void* context) {
+    assert(event->event_data != NULL);
+    (*(int*)context)++;
+}
+
+int event_queue_test(void) {
+    printf("\nEvent Queue Test:\n");
+    printf("================\n\n");
+
+    state_machine_queue_t* queue = state_machine_queue_create();
+    event_t event;
+    int tick_data[3] = {1, 2, 3};
+    int released = 0;
+    state_machine_queue_set_release(queue, count_released_event, &released);
+
+    // Status ticks coalesce on the low lane, errors jump ahead on the high lane
+    state_machine_queue_configure_event(queue, TEST_EVENT_ID_RESET, STATE_MACHINE_QUEUE_PRIORITY_LOW, 1);
+    state_machine_queue_configure_event(queue, TEST_EVENT_ID_ERROR, STATE_MACHINE_QUEUE_PRIORITY_HIGH, 0);
+
+    for (int i = 0; i < 3; i++) {
+        event_t tick = {TEST_EVENT_ID_RESET, sizeof(int), &tick_data[i]};
+        assert(state_machine_queue_post(queue, tick) == 0);
+    }
+    assert(state_machine_queue_post(queue, run_event) == 0);
+    assert(state_machine_queue_post(queue, error_event) == 0);
+    assert(state_machine_queue_count(queue) == 3);
+    assert(queue->coalesced == 2);
+    assert(released == 2);
+    printf("Replaced payloads handed to the release callback\n");
+
+    assert(state_machine_queue_pop(queue, &event) && event.event_id == TEST_EVENT_ID_ERROR);
+    assert(state_machine_queue_pop(queue, &event) && event.event_id == TEST_EVENT_ID_RESET);
+    assert(*(int*)event.event_data == 3);
+    assert(state_machine_queue_pop(queue, &event) && event.event_id == TEST_EVENT_ID_RUN);
+    assert(!state_machine_queue_pop(queue, &event));
+    printf("Coalesced ticks and drained lanes in priority order\n");
+
+    // A tick posted after the previous one was popped queues again
+    state_machine_queue_set_release(queue, NULL, NULL);
+    assert(state_machine_queue_post(queue, reset_event) == 0);
+    assert(state_machine_queue_post(queue, reset_event) == 0);
+    assert(state_machine_queue_count(queue) == 1);
+    assert(state_machine_queue_pop(queue, &event));
+
+    for (int i = 0; i < STATE_MACHINE_QUEUE_SIZE; i++) {
+        assert(state_machine_queue_post(queue, run_event) == 0);
+    }
+    assert(state_machine_queue_post(queue, run_event) == -1);
+    assert(state_machine_queue_post(queue, reset_event) == -1);
+    printf("Rejected post on full queue\n");
+
+    // Drain into a state machine, bouncing between init and run
+    state_machine_t* state_machine = state_machine_create(STATE_MACHINE_STATE_INIT);
+    state_machine_add_transition(state_machine, STATE_MACHINE_STATE_INIT, STATE_MACHINE_STATE_RUN, TEST_EVENT_ID_RUN, NULL);
+    state_machine_add_transition(state_machine, STATE_MACHINE_STATE_RUN, STATE_MACHINE_STATE_ERROR, TEST_EVENT_ID_ERROR, NULL);
+    assert(state_machine_queue_dispatch(queue, state_machine) == STATE_MACHINE_QUEUE_SIZE);
+    assert(state_machine->current_state == STATE_MACHINE_STATE_RUN);
+    assert(state_machine_queue_count(queue) == 0);
+
+    assert(state_machine_queue_post(queue, error_event) == 0);
+    assert(state_machine_queue_dispatch(queue, state_machine) == 1);
+    assert(state_machine->current_state == STATE_MACHINE_STATE_ERROR);
+
+    // Events still pending at destroy are released too
+    released = 0;
+    event_t tick = {TEST_EVENT_ID_RESET, sizeof(int), &tick_data[0]};
+    state_machine_queue_set_release(queue, count_released_event, &released);
+    assert(state_machine_queue_post(queue, tick) == 0);
+
+    state_machine_destroy(state_machine);
+    state_machine_queue_destroy(queue);
+    assert(released == 1);
+    printf("\nEvent queue test completed successfully\n\n");
+    return 0;
+}
+
+int query_index_test(void) {
+    printf("\nQuery Index Test:\n");
+    printf("================\n\n");
+
+    state_machine_t* state_machine = state_machine_create(STATE_MACHINE_STATE_INIT);
+    state_id_t next_state;
+
+    // Nothing configured, only the initial state is reachable
+    assert(state_machine_accepted_events(state_machine) == 0);
+    assert(state_machine_can_reach(state_machine, STATE_MACHINE_STATE_INIT));
+    assert(!state_machine_can_reach(state_machine, STATE_MACHINE_STATE_RUN));
+
+    state_machine_add_transition(state_machine, STATE_MACHINE_STATE_INIT, STATE_MACHINE_STATE_RUN, TEST_EVENT_ID_RUN, NULL);
+    state_machine_add_transition_with_guard(state_machine, STATE_MACHINE_STATE_RUN, STATE_MACHINE_STATE_ERROR, TEST_EVENT_ID_ERROR, NULL, guard_check_data_exists);
+
+    assert(state_machine_accepted_events(state_machine) == (1u << TEST_EVENT_ID_RUN));
+    assert(state_machine_accepts(state_machine, TEST_EVENT_ID_RUN));
+    assert(!state_machine_accepts(state_machine, TEST_EVENT_ID_ERROR));
+    assert(!state_machine_accepts(state_machine, MAX_EVENTS_PER_STATE));
+    assert(state_machine_reachable_states(state_machine) ==
+           ((1u << STATE_MACHINE_STATE_INIT) | (1u << STATE_MACHINE_STATE_RUN) | (1u << STATE_MACHINE_STATE_ERROR)));
+    printf("Accepted events and transitive reachability from init\n");
+
+    // Peek must not fire the transition
+    assert(state_machine_peek(state_machine, TEST_EVENT_ID_RUN, &next_state));
+    assert(next_state == STATE_MACHINE_STATE_RUN);
+    assert(!state_machine_peek(state_machine, TEST_EVENT_ID_RESET, &next_state));
+    assert(state_machine->current_state == STATE_MACHINE_STATE_INIT);
+    printf("Peek reported next state without transitioning\n");
+
+    // Error is a sink until a way back is added
+    state_machine_event(state_machine, run_event);
+    state_machine_event(state_machine, error_event);
+    assert(state_machine->current_state == STATE_MACHINE_STATE_RUN);
+    event_t guarded_error = {TEST_EVENT_ID_ERROR, sizeof(int), &test_data};
+    state_machine_event(state_machine, guarded_error);
+    assert(state_machine->current_state == STATE_MACHINE_STATE_ERROR);
+    assert(!state_machine_can_reach(state_machine, STATE_MACHINE_STATE_INIT));
+
+    state_machine_add_transition(state_machine, STATE_MACHINE_STATE_ERROR, STATE_MACHINE_STATE_INIT, TEST_EVENT_ID_RESET, NULL);
+    assert(state_machine_can_reach(state_machine, STATE_MACHINE_STATE_INIT));
+    assert(state_machine_can_reach(state_machine, STATE_MACHINE_STATE_RUN));
+
+    // Retargeting a transition drops the old edge from the closure
+    state_machine_add_transition(state_machine, STATE_MACHINE_STATE_ERROR, STATE_MACHINE_STATE_ERROR, TEST_EVENT_ID_RESET, NULL);
+    assert(!state_machine_can_reach(state_machine, STATE_MACHINE_STATE_INIT));
+    printf("Reachability follows reconfiguration\n");
+
+    state_machine_destroy(state_machine);
+    printf("\nQuery index test completed successfully\n\n");
+    return 0;
+}
+
+int action_handler_test(void) {
+    printf("\nAction Handler Test:\n");
+    printf("===================\n\n");
+
+    state_machine_t* state_machine = state_machine_create(STATE_MACHINE_STATE_INIT);
+    action_trace_t trace = {{0}, 0, state_machine, 0, 0};
+    state_machine_set_context(state_machine, &trace);
+    legacy_trace = &trace;
+
+    state_machine_assign_on_exit_action(state_machine, STATE_MACHINE_STATE_INIT, trace_exit_action);
+    state_machine_assign_on_enter_action(state_machine, STATE_MACHINE_STATE_RUN, trace_enter_action);
+    state_machine_add_transition_action(state_machine, STATE_MACHINE_STATE_INIT, STATE_MACHINE_STATE_RUN,
+                                        TEST_EVENT_ID_RUN, trace_transition_action, trace_guard_action);
+    state_machine_add_transition(state_machine, STATE_MACHINE_STATE_RUN, STATE_MACHINE_STATE_INIT, TEST_EVENT_ID_RESET, NULL);
+    assert(!(state_machine->state_transitions[STATE_MACHINE_STATE_INIT][TEST_EVENT_ID_RUN].flags & STATE_MACHINE_LEGACY_ACTION));
+    assert(state_machine->state_table[STATE_MACHINE_STATE_RUN].on_enter_context == &trace);
+    assert(state_machine->handler_kinds == STATE_MACHINE_KIND_ACTION);
+
+    // Guard receives the event by pointer
+    state_machine_event(state_machine, run_event);
+    assert(state_machine->current_state == STATE_MACHINE_STATE_INIT);
+    assert(trace.length == 0);
+
+    test_data = 42;
+    event_t guarded_run = {TEST_EVENT_ID_RUN, sizeof(int), &test_data};
+    state_machine_dispatch(state_machine, &guarded_run);
+    assert(state_machine->current_state == STATE_MACHINE_STATE_RUN);
+    assert(trace.length == 3 && memcmp(trace.trace, "xtn", 3) == 0);
+    assert(trace.state_seen_on_exit == STATE_MACHINE_STATE_INIT);
+    assert(trace.state_seen_on_enter == STATE_MACHINE_STATE_RUN);
+    printf("Exit, transition and enter actions ran in order with context\n");
+
+    // A legacy enter handler replaces the action handler in the same slot
+    state_machine_assign_on_enter_handler(state_machine, STATE_MACHINE_STATE_RUN, trace_legacy_enter_handler);
+    state_machine_event(state_machine, reset_event);
+    trace.length = 0;
+    state_machine_dispatch(state_machine, &guarded_run);
+    assert(trace.length == 3 && memcmp(trace.trace, "xtN", 3) == 0);
+    assert(state_machine->handler_kinds == (STATE_MACHINE_KIND_LEGACY | STATE_MACHINE_KIND_ACTION));
+    printf("Legacy enter handler replaced the enter action\n");
+
+    // A legacy transition replaces the pointer-passing one
+    state_machine_event(state_machine, reset_event);
+    state_machine_add_transition(state_machine, STATE_MACHINE_STATE_INIT, STATE_MACHINE_STATE_RUN, TEST_EVENT_ID_RUN, NULL);
+    trace.length = 0;
+    state_machine_event(state_machine, run_event);
+    assert(state_machine->current_state == STATE_MACHINE_STATE_RUN);
+    assert(trace.length == 2 && memcmp(trace.trace, "xN", 2) == 0);
+
+    // Bound handlers keep their own context when the instance context changes
+    action_trace_t bound = {{0}, 0, state_machine, 0, 0};
+    state_machine_event(state_machine, reset_event);
+    state_machine_assign_on_exit_action_with_context(state_machine, STATE_MACHINE_STATE_INIT, trace_exit_action, &bound);
+    state_machine_add_transition_action_with_context(state_machine, STATE_MACHINE_STATE_INIT, STATE_MACHINE_STATE_RUN,
+                                                     TEST_EVENT_ID_RUN, trace_transition_action, &bound,
+                                                     trace_guard_action, NULL);
+    state_machine_set_context(state_machine, NULL);
+    trace.length = 0;
+    state_machine_dispatch(state_machine, &guarded_run);
+    assert(state_machine->current_state == STATE_MACHINE_STATE_RUN);
+    assert(bound.length == 2 && memcmp(bound.trace, "xt", 2) == 0);
+    assert(trace.length == 1 && trace.trace[0] == 'N');
+    printf("Bound contexts survived an instance context change\n");
+    state_machine_destroy(state_machine);
+
+    // The dispatch path follows the signatures in use as handlers come and go
+    state_machine = state_machine_create(STATE_MACHINE_STATE_INIT);
+    state_machine_add_transition(state_machine, STATE_MACHINE_STATE_INIT, STATE_MACHINE_STATE_RUN, TEST_EVENT_ID_RUN, NULL);
+    state_machine_add_transition(state_machine, STATE_MACHINE_STATE_RUN, STATE_MACHINE_STATE_INIT, TEST_EVENT_ID_RESET, NULL);
+    assert(state_machine->handler_kinds == 0);
+    state_machine_assign_on_enter_handler(state_machine, STATE_MACHINE_STATE_RUN, trace_legacy_enter_handler);
+    assert(state_machine->handler_kinds == STATE_MACHINE_KIND_LEGACY);
+    trace.length = 0;
+    state_machine_event(state_machine, run_event);
+    assert(trace.length == 1 && trace.trace[0] == 'N');
+    state_machine_assign_on_enter_action(state_machine, STATE_MACHINE_STATE_RUN, NULL);
+    assert(state_machine->handler_kinds == 0);
+    state_machine_event(state_machine, reset_event);
+    state_machine_event(state_machine, run_event);
+    assert(state_machine->current_state == STATE_MACHINE_STATE_RUN && trace.length == 1);
+    printf("Handler kinds tracked for single-signature dispatch\n");
+
+    state_machine_destroy(state_machine);
+    printf("\nAction handler test completed successfully\n\n");
+    return 0;
+}
+
+// Records notifications as characters, 'e'vent, 't'ransition and 'd'estroy
+static void trace_observer(state_machine_t* state_machine, int notification, void* context) {
+    action_trace_t* trace = (action_trace_t*)context;
+    trace->trace[trace->length++] = "etd"[notification];
+}
+
+int observer_test(void) {
+    printf("\nObserver Test:\n");
+    printf("==============\n\n");
+
+    action_trace_t traces[STATE_MACHINE_OBSERVERS_MAX];
+    memset(traces, 0, sizeof(traces));
+    state_machine_t* state_machine = state_machine_create(STATE_MACHINE_STATE_INIT);
+    state_machine_add_transition(state_machine, STATE_MACHINE_STATE_INIT, STATE_MACHINE_STATE_RUN, TEST_EVENT_ID_RUN, NULL);
+    for (int i = 0; i < STATE_MACHINE_OBSERVERS_MAX; i++) {
+        assert(state_machine_add_observer(state_machine, trace_observer, &traces[i]) == 0);
+    }
+    assert(state_machine_add_observer(state_machine, trace_observer, &traces[0]) == -1);
+    assert(state_machine_observer_context(state_machine, trace_observer) == &traces[0]);
+
+    state_machine_event(state_machine, error_event);
+    state_machine_event(state_machine, run_event);
+    for (int i = 0; i < STATE_MACHINE_OBSERVERS_MAX; i++) {
+        assert(traces[i].length == 2 && memcmp(traces[i].trace, "et", 2) == 0);
+    }
+    printf("Observers told about events and transitions\n");
+
+    assert(state_machine_remove_observer(state_machine, trace_observer, &traces[0]) == 0);
+    assert(state_machine_remove_observer(state_machine, trace_observer, &traces[0]) == -1);
+    assert(state_machine_observer_context(state_machine, trace_observer) == &traces[1]);
+    state_machine_destroy(state_machine);
+    assert(traces[0].length == 2);
+    for (int i = 1; i < STATE_MACHINE_OBSERVERS_MAX; i++) {
+        assert(traces[i].length == 3 && memcmp(traces[i].trace, "etd", 3) == 0);
+    }
+    printf("Removed observer silent, remaining one told about destroy\n");
+
+    printf("\nObserver test completed successfully\n\n");
+    return 0;
+}
+
+int shm_test(void) {
+    printf("\nShared Memory Test:\n");
+    printf("==================\n\n");
+
+    char name[64];
+    snprintf(name, sizeof(name), "/esm_test_%d", (int)getpid());
+    state_machine_shm_t* shm = state_machine_shm_create(name, 4);
+    assert(shm != NULL);
+    assert(state_machine_shm_capacity(shm) == 4);
+    // A live segment is never taken over
+    assert(state_machine_shm_create(name, 4) == NULL);
+
+    // Toggle between init and run on every event
+    state_machine_t* state_machine = state_machine_create(STATE_MACHINE_STATE_INIT);
+    state_machine_add_transition(state_machine, STATE_MACHINE_STATE_INIT, STATE_MACHINE_STATE_RUN, TEST_EVENT_ID_RUN, NULL);
+    state_machine_add_transition(state_machine, STATE_MACHINE_STATE_RUN, STATE_MACHINE_STATE_INIT, TEST_EVENT_ID_RUN, NULL);
+    state_machine_attach_shm(state_machine, state_machine_shm_entry(shm, 1));
+
+    state_machine_t* other = state_machine_create(STATE_MACHINE_STATE_INIT);
+    state_machine_attach_shm(other, state_machine_shm_entry(shm, 3));
+    state_machine_event(other, error_event);
+
+    fflush(stdout);
+    pid_t child = fork();
+    assert(child >= 0);
+    if (child == 0) {
+        // Monitor process: every snapshot must be internally consistent
+        state_machine_shm_t* monitor = state_machine_shm_open(name);
+        if (!monitor || state_machine_shm_capacity(monitor) != 4) {
+            _exit(1);
+        }
+        state_machine_shm_snapshot_t snapshot;
+        do {
+            state_machine_shm_snapshot(state_machine_shm_entry(monitor, 1), &snapshot);
+            if (snapshot.in_use && (snapshot.transitions != snapshot.events_processed ||
+                                    snapshot.current_state != (snapshot.transitions & 1))) {
+                _exit(2);
+            }
+        } while (!snapshot.in_use || snapshot.events_processed < SHM_NUM_EVENTS);
+        state_machine_shm_close(monitor);
+        _exit(0);
+    }
+
+    for (int i = 0; i < SHM_NUM_EVENTS; i++) {
+        state_machine_event(state_machine, run_event);
+    }
+
+    int status = 0;
+    assert(waitpid(child, &status, 0) == child);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    printf("Monitor process read consistent snapshots while dispatching\n");
+
+    state_machine_shm_snapshot_t snapshot;
+    state_machine_shm_snapshot(state_machine_shm_entry(shm, 3), &snapshot);
+    assert(snapshot.in_use && snapshot.events_processed == 1 && snapshot.transitions == 0);
+    state_machine_shm_snapshot(state_machine_shm_entry(shm, 0), &snapshot);
+    assert(!snapshot.in_use);
+
+    state_machine_attach_shm(other, NULL);
+    state_machine_shm_snapshot(state_machine_shm_entry(shm, 3), &snapshot);
+    assert(!snapshot.in_use);
+    printf("Detached instance marked unused\n");
+
+    // Destroying an attached instance releases its entry
+    state_machine_destroy(state_machine);
+    state_machine_shm_snapshot(state_machine_shm_entry(shm, 1), &snapshot);
+    assert(!snapshot.in_use);
+    printf("Destroyed instance marked unused\n");
+
+    state_machine_destroy(other);
+    state_machine_shm_close(shm);
+    assert(state_machine_shm_open(name) == NULL);
+    assert(state_machine_shm_unlink(name) == -1);
+
+    // A stale segment has to be removed explicitly before its name is reused
+    shm = state_machine_shm_create(name, 2);
+    assert(shm != NULL);
+    shm->owner = 0;  // as if the owner had crashed
+    state_machine_shm_close(shm);
+    assert(state_machine_shm_create(name, 2) == NULL);
+    assert(state_machine_shm_unlink(name) == 0);
+    shm = state_machine_shm_create(name, 2);
+    assert(shm != NULL);
+    state_machine_shm_close(shm);
+    printf("Existing segment refused until unlinked\n");
+
+    printf("\nShared memory test completed successfully\n\n");
+    return 0;
+}
+
+static state_machine_t* create_live_definition(void) {
+    state_machine_t* definition = state_machine_create(STATE_MACHINE_STATE_INIT);
+    state_machine_add_transition(definition, STATE_MACHINE_STATE_INIT, STATE_MACHINE_STATE_RUN, TEST_EVENT_ID_RUN, NULL);
+    state_machine_add_transition(definition, STATE_MACHINE_STATE_RUN, STATE_MACHINE_STATE_INIT, TEST_EVENT_ID_RESET, NULL);
+    return definition;
+}
+
+// Starts in run, as a reload of a long running service would
+static state_machine_t* create_live_reload_definition(void) {
+    state_machine_t* definition = state_machine_create(STATE_MACHINE_STATE_RUN);
+    state_machine_add_transition(definition, STATE_MACHINE_STATE_RUN, STATE_MACHINE_STATE_INIT, TEST_EVENT_ID_RESET, NULL);
+    return definition;
+}
+
+typedef struct {
+    state_machine_live_t* live;
+    atomic_int stop;
+    atomic_ulong rounds;
+    uint64_t transitions;
+} live_dispatch_args_t;
+
+static void* live_dispatch_thread(void* arg) {
+    live_dispatch_args_t* args = (live_dispatch_args_t*)arg;
+    int reader = state_machine_live_register_reader(args->live);
+    assert(reader >= 0);
+
+    state_machine_live_instance_t instance;
+    state_machine_live_instance_init(args->live, &instance);
+    while (!atomic_load(&args->stop)) {
+        args->transitions += state_machine_live_event(args->live, reader, &instance, &run_event);
+        args->transitions += state_machine_live_event(args->live, reader, &instance, &reset_event);
+        atomic_fetch_add(&args->rounds, 1);
+    }
+
+    state_machine_live_unregister_reader(args->live, reader);
+    return NULL;
+}
+
+typedef struct {
+    state_machine_live_t* live;
+    int reader;
+    state_machine_live_instance_t* inner;
+    uint32_t pending;
+} live_nested_args_t;
+
+// Dispatches on another instance from inside a transition, then retires the running version
+static void live_nested_action(const event_t* event, void* context) {
+    live_nested_args_t* args = (live_nested_args_t*)context;
+    (void)event;
+    assert(state_machine_live_event(args->live, args->reader, args->inner, &run_event));
+    state_machine_live_publish(args->live, create_live_definition(), NULL);
+    args->pending = state_machine_live_reclaim(args->live);
+}
+
+int live_swap_test(void) {
+    printf("\nLive Swap Test:\n");
+    printf("==============\n\n");
+
+    state_machine_live_t* live = state_machine_live_create(create_live_definition());
+    int reader = state_machine_live_register_reader(live);
+    assert(reader >= 0);
+
+    state_machine_live_instance_t instance;
+    state_machine_live_instance_t lagging;
+    state_machine_live_instance_init(live, &instance);
+    state_machine_live_instance_init(live, &lagging);
+    assert(instance.current_state == STATE_MACHINE_STATE_INIT && instance.version == 1);
+
+    assert(state_machine_live_event(live, reader, &instance, &run_event));
+    assert(!state_machine_live_event(live, reader, &instance, &error_event));
+    assert(instance.current_state == STATE_MACHINE_STATE_RUN);
+
+    // Version 2 adds run -> error, ids unchanged
+    state_machine_t* definition = create_live_definition();
+    state_machine_add_transition(definition, STATE_MACHINE_STATE_RUN, STATE_MACHINE_STATE_ERROR, TEST_EVENT_ID_ERROR, NULL);
+    assert(state_machine_live_publish(live, definition, NULL) == 2);
+    assert(state_machine_live_event(live, reader, &instance, &error_event));
+    assert(instance.current_state == STATE_MACHINE_STATE_ERROR && instance.version == 2);
+    printf("New transition visible after publish\n");
+
+    // Version 3 swaps the ids of init and error
+    state_id_t remap[STATE_MACHINE_STATE_MAX];
+    for (int i = 0; i < STATE_MACHINE_STATE_MAX; i++) {
+        remap[i] = i;
+    }
+    remap[STATE_MACHINE_STATE_INIT] = STATE_MACHINE_STATE_ERROR;
+    remap[STATE_MACHINE_STATE_ERROR] = STATE_MACHINE_STATE_INIT;
+    definition = state_machine_create(STATE_MACHINE_STATE_ERROR);
+    state_machine_add_transition(definition, STATE_MACHINE_STATE_INIT, STATE_MACHINE_STATE_RUN, TEST_EVENT_ID_RUN, NULL);
+    assert(state_machine_live_publish(live, definition, remap) == 3);
+    assert(state_machine_live_version(live) == 3);
+
+    assert(state_machine_live_event(live, reader, &instance, &run_event));
+    assert(instance.current_state == STATE_MACHINE_STATE_RUN);
+
+    // Two versions behind, both remaps are applied
+    assert(!state_machine_live_event(live, reader, &lagging, &reset_event));
+    assert(lagging.current_state == STATE_MACHINE_STATE_ERROR && lagging.version == 3);
+    printf("Instances remapped across versions\n");
+
+    // Routine reloads that keep ids unchanged never invalidate a lagging instance
+    for (int i = 0; i <= STATE_MACHINE_LIVE_REMAP_HISTORY; i++) {
+        state_machine_live_publish(live, create_live_reload_definition(), NULL);
+    }
+    assert(!state_machine_live_event(live, reader, &lagging, &error_event));
+    assert(lagging.current_state == STATE_MACHINE_STATE_ERROR && lagging.resets == 0);
+    assert(lagging.version == state_machine_live_version(live));
+    printf("Instance %d identity reloads behind kept its state\n", STATE_MACHINE_LIVE_REMAP_HISTORY + 1);
+
+    // A remap that moved ids and fell out of the history puts it back in the initial state
+    state_machine_live_publish(live, create_live_reload_definition(), remap);
+    for (int i = 1; i <= STATE_MACHINE_LIVE_REMAP_HISTORY; i++) {
+        state_machine_live_publish(live, create_live_reload_definition(), NULL);
+    }
+    assert(!state_machine_live_event(live, reader, &lagging, &error_event));
+    assert(lagging.current_state == STATE_MACHINE_STATE_RUN && lagging.resets == 1);
+    assert(lagging.version == state_machine_live_version(live));
+    assert(instance.resets == 0);
+    printf("Instance %d versions behind a remap reset to the initial state\n", STATE_MACHINE_LIVE_REMAP_HISTORY + 1);
+
+    // A nested dispatch must not end the outer one's protection of its version
+    state_machine_live_instance_t inner;
+    live_nested_args_t nested = {live, reader, &inner, 0};
+    definition = create_live_definition();
+    state_machine_add_transition_action_with_context(definition, STATE_MACHINE_STATE_INIT, STATE_MACHINE_STATE_ERROR,
+                                                     TEST_EVENT_ID_ERROR, live_nested_action, &nested, NULL, NULL);
+    state_machine_live_publish(live, definition, NULL);
+    state_machine_live_instance_init(live, &instance);
+    state_machine_live_instance_init(live, &inner);
+    assert(state_machine_live_event(live, reader, &instance, &error_event));
+    assert(nested.pending == 1);
+    assert(instance.current_state == STATE_MACHINE_STATE_ERROR);
+    assert(inner.current_state == STATE_MACHINE_STATE_RUN);
+    printf("Nested dispatch keeps the outer version alive\n");
+
+    assert(state_machine_live_reclaim(live) == 0);
+    state_machine_live_unregister_reader(live, reader);
+
+    // Hot reload while another thread dispatches flat out
+    uint32_t base_version = state_machine_live_publish(live, create_live_definition(), NULL);
+    live_dispatch_args_t args = {live, 0, 0, 0};
+    pthread_t thread;
+    assert(pthread_create(&thread, NULL, live_dispatch_thread, &args) == 0);
+    for (int i = 0; i < LIVE_NUM_PUBLISHES; i++) {
+        // Let the dispatcher make progress between publishes
+        unsigned long rounds = atomic_load(&args.rounds);
+        while (atomic_load(&args.rounds) == rounds) {
+            sched_yield();
+        }
+        state_machine_live_publish(live, create_live_definition(), NULL);
+    }
+    atomic_store(&args.stop, 1);
+    assert(pthread_join(thread, NULL) == 0);
+
+    assert(state_machine_live_reclaim(live) == 0);
+    assert(state_machine_live_version(live) == base_version + LIVE_NUM_PUBLISHES);
+    assert(args.transitions > 0);
+    printf("Published %d versions under load, %llu transitions\n",
+           LIVE_NUM_PUBLISHES, (unsigned long long)args.transitions);
+
+    state_machine_live_destroy(live);
+    printf("\nLive swap test completed successfully\n\n");
+    return 0;
+}
+
+int latency_test(void) {
+    printf("\nLatency Histogram Test:\n");
+    printf("======================\n\n");
+
+    // Buckets tile the value range without gaps
+    for (int i = 0; i + 1 < STATE_MACHINE_HIST_BUCKETS; i++) {
+        assert(state_machine_hist_bucket_low(i) <= state_machine_hist_bucket_high(i));
+        assert(state_machine_hist_bucket_high(i) + 1 == state_machine_hist_bucket_low(i + 1));
+        // Width relative to the lowest value in the bucket stays within the stated precision
+        uint64_t width = state_machine_hist_bucket_high(i) - state_machine_hist_bucket_low(i) + 1;
+        assert(width * (STATE_MACHINE_HIST_SUB_BUCKETS / 2) <= state_machine_hist_bucket_low(i) ||
+               i < STATE_MACHINE_HIST_SUB_BUCKETS);
+    }
+
+    state_machine_hist_t hist;
+    state_machine_hist_reset(&hist);
+    for (uint64_t value = 1; value <= 1000; value++) {
+        state_machine_hist_record(&hist, value * 1000);
+    }
+    assert(hist.total_count == 1000 && hist.min_ns == 1000 && hist.max_ns == 1000000);
+    uint64_t p50 = state_machine_hist_percentile(&hist, 50.0);
+    uint64_t p999 = state_machine_hist_percentile(&hist, 99.9);
+    assert(p50 >= 500000 && p50 <= 500000 * 1.03125);
+    assert(p999 >= 999000 && p999 <= 1000000);
+    assert(state_machine_hist_percentile(&hist, 100.0) == 1000000);
+    printf("Percentiles within bucket precision\n");
+
+    // Dispatch through a tracked queue
+    state_machine_latency_t* latency = state_machine_latency_create(1);
+    state_machine_queue_t* queue = state_machine_queue_create();
+    state_machine_queue_set_latency(queue, latency);
+
+    state_machine_t* state_machine = state_machine_create(STATE_MACHINE_STATE_INIT);
+    state_machine_add_transition(state_machine, STATE_MACHINE_STATE_INIT, STATE_MACHINE_STATE_RUN, TEST_EVENT_ID_RUN, NULL);
+    state_machine_add_transition(state_machine, STATE_MACHINE_STATE_RUN, STATE_MACHINE_STATE_INIT, TEST_EVENT_ID_RESET, NULL);
+
+    for (int i = 0; i < 10; i++) {
+        assert(state_machine_queue_post(queue, run_event) == 0);
+        assert(state_machine_queue_post(queue, reset_event) == 0);
+    }
+    assert(state_machine_queue_dispatch(queue, state_machine) == 20);
+    assert(latency->queue_wait.total_count == 20);
+    assert(latency->service.total_count == 20);
+    assert(latency->end_to_end.total_count == 20);
+    assert(latency->end_to_end.max_ns >= latency->service.max_ns);
+    assert(state_machine_latency_transition(latency, STATE_MACHINE_STATE_INIT, TEST_EVENT_ID_RUN)->total_count == 10);
+    assert(state_machine_latency_transition(latency, STATE_MACHINE_STATE_RUN, TEST_EVENT_ID_RESET)->total_count == 10);
+    assert(state_machine_latency_transition(latency, STATE_MACHINE_STATE_INIT, TEST_EVENT_ID_RESET)->total_count == 0);
+    printf("Recorded wait, service and per transition latency\n");
+
+    // Fold a second group in and export the result
+    state_machine_latency_t* other = state_machine_latency_create(0);
+    state_machine_queue_set_latency(queue, other);
+    assert(state_machine_queue_post(queue, run_event) == 0);
+    assert(state_machine_queue_dispatch(queue, state_machine) == 1);
+    state_machine_latency_merge(latency, other);
+    assert(latency->service.total_count == 21);
+    assert(state_machine_latency_transition(other, STATE_MACHINE_STATE_INIT, TEST_EVENT_ID_RUN) == NULL);
+
+    FILE* file = tmpfile();
+    assert(file != NULL);
+    assert(state_machine_hist_export(&latency->service, file) == 0);
+    rewind(file);
+    unsigned long long low, high, count, exported = 0;
+    while (fscanf(file, "%llu %llu %llu", &low, &high, &count) == 3) {
+        assert(low <= high && count > 0);
+        exported += count;
+    }
+    assert(exported == 21);
+    fclose(file);
+    printf("Merged and exported histograms\n");
+
+    state_machine_destroy(state_machine);
+    state_machine_queue_destroy(queue);
+    state_machine_latency_destroy(latency);
+    state_machine_latency_destroy(other);
+    printf("\nLatency histogram test completed successfully\n\n");
+    return 0;
+}
+
+// Forwards the event to the instance in the context once this one has entered its state
+static void forward_to_partner_action(const event_t* event, void* context) {
+    state_machine_dispatch((state_machine_t*)context, event);
+}
+
+int group_broadcast_test(void) {
+    printf("\nGroup Broadcast Test:\n");
+    printf("====================\n\n");
+
+    state_machine_group_t* group = state_machine_group_create();
+    state_machine_t* instances[GROUP_NUM_INSTANCES];
+    for (int i = 0; i < GROUP_NUM_INSTANCES; i++) {
+        instances[i] = state_machine_create(STATE_MACHINE_STATE_INIT);
+        state_machine_add_transition(instances[i], STATE_MACHINE_STATE_INIT, STATE_MACHINE_STATE_RUN, TEST_EVENT_ID_RUN, NULL);
+        state_machine_add_transition(instances[i], STATE_MACHINE_STATE_RUN, STATE_MACHINE_STATE_ERROR, TEST_EVENT_ID_ERROR, NULL);
+        state_machine_add_transition(instances[i], STATE_MACHINE_STATE_ERROR, STATE_MACHINE_STATE_INIT, TEST_EVENT_ID_RESET, NULL);
+        state_machine_group_add(group, instances[i]);
+    }
+    assert(group->count == GROUP_NUM_INSTANCES);
+    assert(state_machine_group_population(group, STATE_MACHINE_STATE_INIT) == GROUP_NUM_INSTANCES);
+
+    // Ordinary dispatch keeps the index current
+    for (int i = 0; i < GROUP_NUM_INSTANCES; i += 2) {
+        state_machine_event(instances[i], run_event);
+    }
+    assert(state_machine_group_population(group, STATE_MACHINE_STATE_INIT) == GROUP_NUM_INSTANCES / 2);
+    assert(state_machine_group_population(group, STATE_MACHINE_STATE_RUN) == GROUP_NUM_INSTANCES / 2);
+
+    int listed = 0;
+    for (state_machine_t* it = state_machine_group_first(group, STATE_MACHINE_STATE_RUN); it; it = state_machine_group_next(it)) {
+        assert(it->current_state == STATE_MACHINE_STATE_RUN);
+        listed++;
+    }
+    assert(listed == GROUP_NUM_INSTANCES / 2);
+    printf("Population tracked through dispatch\n");
+
+    // Only instances in run receive the error
+    assert(state_machine_group_broadcast(group, STATE_MACHINE_STATE_RUN, &error_event) == GROUP_NUM_INSTANCES / 2);
+    assert(state_machine_group_population(group, STATE_MACHINE_STATE_RUN) == 0);
+    assert(state_machine_group_population(group, STATE_MACHINE_STATE_ERROR) == GROUP_NUM_INSTANCES / 2);
+    assert(state_machine_group_broadcast(group, STATE_MACHINE_STATE_RUN, &error_event) == 0);
+    printf("Broadcast reached only instances in the target state\n");
+
+    // Handlers that push the event to the next instance in the list mid broadcast
+    for (int i = 0; i < GROUP_NUM_INSTANCES; i++) {
+        state_machine_assign_on_enter_action(instances[i], STATE_MACHINE_STATE_RUN, forward_to_partner_action);
+    }
+    for (state_machine_t* it = state_machine_group_first(group, STATE_MACHINE_STATE_INIT); it; it = state_machine_group_next(it)) {
+        state_machine_set_context(it, state_machine_group_next(it) ? state_machine_group_next(it) : it);
+    }
+    uint32_t sent = state_machine_group_broadcast(group, STATE_MACHINE_STATE_INIT, &run_event);
+    assert(sent == 1);
+    assert(state_machine_group_population(group, STATE_MACHINE_STATE_INIT) == 0);
+    assert(state_machine_group_population(group, STATE_MACHINE_STATE_RUN) == GROUP_NUM_INSTANCES / 2);
+    printf("Broadcast survived handlers reshuffling the list\n");
+
+    // Destroying a member drops it from the index
+    state_machine_destroy(instances[0]);
+    assert(group->count == GROUP_NUM_INSTANCES - 1);
+    assert(state_machine_group_population(group, STATE_MACHINE_STATE_ERROR) == GROUP_NUM_INSTANCES / 2 - 1);
+
+    state_machine_group_destroy(group);
+    for (int i = 1; i < GROUP_NUM_INSTANCES; i++) {
+        assert(instances[i]->group == NULL);
+        state_machine_destroy(instances[i]);
+    }
+    printf("\nGroup broadcast test completed successfully\n\n");
+    return 0;
+}
+
+// Runs on the dispatcher thread only
+static void count_dispatched_action(const event_t* event, void* context) {
+    (*(unsigned long*)context)++;
+}
+
+static void* dispatcher_producer(void* arg) {
+    state_machine_dispatcher_t* dispatcher = (state_machine_dispatcher_t*)arg;
+    for (int i = 0; i < DISPATCHER_NUM_EVENTS; i++) {
+        while (state_machine_dispatcher_post(dispatcher, run_event) != 0) {
+            sched_yield();
+        }
+        // Go quiet now and then so the consumer gets to park
+        if (i % 1000 == 0) {
+            usleep(200);
+        }
+    }
+    return NULL;
+}
+
+int dispatcher_test(void) {
+    printf("\nDispatcher Test:\n");
+    printf("================\n\n");
+
+    unsigned long dispatched = 0;
+    state_machine_t* state_machine = state_machine_create(STATE_MACHINE_STATE_INIT);
+    state_machine_set_context(state_machine, &dispatched);
+    state_machine_add_transition_action(state_machine, STATE_MACHINE_STATE_INIT, STATE_MACHINE_STATE_INIT,
+                                        TEST_EVENT_ID_RUN, count_dispatched_action, NULL);
+    state_machine_queue_t* queue = state_machine_queue_create();
+
+    // Idle consumer parks on the futex, posts while running need no syscall
+    state_machine_dispatcher_t* dispatcher = state_machine_dispatcher_create(state_machine, queue, 0);
+    assert(state_machine_dispatcher_fd(dispatcher) == -1);
+    assert(state_machine_dispatcher_wait(dispatcher, 10) == 0);
+    assert(dispatcher->parks == 1);
+    assert(state_machine_dispatcher_post(dispatcher, run_event) == 0);
+    assert(atomic_load(&dispatcher->wakes) == 0);
+    assert(state_machine_dispatcher_wait(dispatcher, 10) == 1 && dispatched == 1);
+    printf("Idle wait parked, post to a running consumer made no wake call\n");
+
+    // Producer threads against a parking consumer thread
+    dispatched = 0;
+    pthread_t consumer;
+    pthread_t producers[DISPATCHER_NUM_PRODUCERS];
+    pthread_create(&consumer, NULL, state_machine_dispatcher_run, dispatcher);
+    for (int i = 0; i < DISPATCHER_NUM_PRODUCERS; i++) {
+        pthread_create(&producers[i], NULL, dispatcher_producer, dispatcher);
+    }
+    for (int i = 0; i < DISPATCHER_NUM_PRODUCERS; i++) {
+        pthread_join(producers[i], NULL);
+    }
+    state_machine_dispatcher_stop(dispatcher);
+    pthread_join(consumer, NULL);
+    assert(dispatched == (unsigned long)DISPATCHER_NUM_PRODUCERS * DISPATCHER_NUM_EVENTS);
+    uint64_t wakes = atomic_load(&dispatcher->wakes);
+    assert(wakes <= dispatcher->parks);
+    printf("%lu events from %d producers: %lu parks, %lu wake calls, %lu spin hits\n",
+           dispatched, DISPATCHER_NUM_PRODUCERS, (unsigned long)dispatcher->parks,
+           (unsigned long)wakes, (unsigned long)dispatcher->spin_hits);
+    state_machine_dispatcher_destroy(dispatcher);
+
+    // External epoll loop on the eventfd, with latency tracking
+    dispatched = 0;
+    state_machine_latency_t* latency = state_machine_latency_create(1);
+    state_machine_queue_set_latency(queue, latency);
+    dispatcher = state_machine_dispatcher_create(state_machine, queue, STATE_MACHINE_DISPATCHER_EVENTFD);
+    assert(dispatcher != NULL);
+    int fd = state_machine_dispatcher_fd(dispatcher);
+    assert(fd >= 0);
+    int epoll_fd = epoll_create1(0);
+    struct epoll_event watch = {0};
+    watch.events = EPOLLIN;
+    assert(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &watch) == 0);
+    struct epoll_event ready;
+
+    assert(state_machine_dispatcher_prepare_wait(dispatcher) == 0);
+    assert(epoll_wait(epoll_fd, &ready, 1, 0) == 0);
+    assert(state_machine_dispatcher_post(dispatcher, run_event) == 0);
+    assert(state_machine_dispatcher_post(dispatcher, run_event) == 0);
+    assert(atomic_load(&dispatcher->wakes) == 1);
+    assert(epoll_wait(epoll_fd, &ready, 1, 1000) == 1);
+    assert(state_machine_dispatcher_run_once(dispatcher) == 2 && dispatched == 2);
+    printf("Two posts to a parked loop shared one eventfd wakeup\n");
+    assert(latency->end_to_end.total_count == 2 && latency->queue_wait.total_count == 2);
+    assert(state_machine_latency_transition(latency, STATE_MACHINE_STATE_INIT, TEST_EVENT_ID_RUN)->total_count == 2);
+    printf("Dispatched events recorded in the queue's latency tracker\n");
+
+    assert(state_machine_dispatcher_prepare_wait(dispatcher) == 0);
+    assert(epoll_wait(epoll_fd, &ready, 1, 0) == 0);
+    assert(state_machine_dispatcher_post(dispatcher, run_event) == 0);
+    assert(state_machine_dispatcher_prepare_wait(dispatcher) == 1);
+    assert(state_machine_dispatcher_run_once(dispatcher) == 1);
+    assert(epoll_wait(epoll_fd, &ready, 1, 0) == 0);
+    printf("Readiness cleared by run_once, prepare_wait refuses with events pending\n");
+
+    close(epoll_fd);
+    state_machine_dispatcher_destroy(dispatcher);
+    state_machine_queue_destroy(queue);
+    state_machine_latency_destroy(latency);
+    state_machine_destroy(state_machine);
+    printf("\nDispatcher test completed successfully\n\n");
+    return 0;
+}
+
 // Modify main() to include the new test
 int main(void) {
     print_structure_statistics();
@@ -501,6 +1362,15 @@ int main(void) {
     visualization_test();
     performance_test();
     guard_condition_test();
+    event_queue_test();
+    query_index_test();
+    action_handler_test();
+    observer_test();
+    shm_test();
+    live_swap_test();
+    latency_test();
+    group_broadcast_test();
+    dispatcher_test();
     fuzz_test();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,250 @@
+/**
+ * Copyright (c) 2025 Nicholas Daniell
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "state_machine.hpp"
+
+#define CPP_PERF_NUM_ITERATIONS 1000000
+#define CPP_PERF_NUM_ROUNDS 5
+#define CPP_PERF_NUM_TRANSITIONS 5
+
+// Counts every allocation made through operator new
+static long allocation_count = 0;
+
+void *operator new(std::size_t size) {
+    allocation_count++;
+    void *p = std::malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
+typedef enum {
+    STATE_INIT,
+    STATE_RUN,
+    STATE_ERROR,
+} test_state_t;
+
+typedef enum {
+    EVENT_RESET,
+    EVENT_RUN,
+    EVENT_ERROR,
+} test_event_t;
+
+static const event_t reset_event = {EVENT_RESET, 0, NULL};
+static const event_t run_event = {EVENT_RUN, 0, NULL};
+static const event_t error_event = {EVENT_ERROR, 0, NULL};
+
+// Functor counting its live copies, to check storage releases replaced handlers
+struct counted_handler {
+    static int live;
+    int *hits;
+    explicit counted_handler(int *hits) : hits(hits) { live++; }
+    counted_handler(const counted_handler &other) : hits(other.hits) { live++; }
+    counted_handler(counted_handler &&other) noexcept : hits(other.hits) { live++; }
+    ~counted_handler() { live--; }
+    void operator()(const event_t &) const { (*hits)++; }
+};
+int counted_handler::live = 0;
+
+static_assert(std::is_nothrow_move_constructible<esm::state_machine>::value, "moves must not throw");
+static_assert(std::is_nothrow_move_assignable<esm::state_machine>::value, "moves must not throw");
+static_assert(!std::is_copy_constructible<esm::state_machine>::value, "state_machine is move-only");
+
+void wrapper_test(void) {
+    printf("\nC++ Wrapper Test:\n");
+    printf("=================\n\n");
+
+    char trace[16] = {0};
+    int length = 0;
+    int allowed = 0;
+
+    esm::state_machine machine(STATE_INIT);
+    machine.add_transition(STATE_INIT, STATE_RUN, EVENT_RUN,
+                           [&trace, &length](const event_t &) { trace[length++] = 't'; },
+                           [&allowed](const event_t &) { return allowed != 0; });
+    machine.add_transition(STATE_RUN, STATE_INIT, EVENT_RESET);
+    machine.on_exit(STATE_INIT, [&trace, &length](const event_t &) { trace[length++] = 'x'; });
+    state_machine_t *raw = machine.get();
+    machine.on_enter(STATE_RUN, [&trace, &length, raw](const event_t &) {
+        assert(raw->current_state == STATE_RUN);
+        trace[length++] = 'n';
+    });
+
+    // Guard lambda sees captured state
+    machine.dispatch(run_event);
+    assert(machine.current_state() == STATE_INIT && length == 0);
+    allowed = 1;
+    machine.dispatch(run_event);
+    assert(machine.current_state() == STATE_RUN);
+    assert(length == 3 && memcmp(trace, "xtn", 3) == 0);
+    printf("Exit, transition and enter lambdas ran in order\n");
+
+    // No allocation while dispatching
+    long before = allocation_count;
+    for (int i = 0; i < 1000; i++) {
+        length = 0;
+        machine.dispatch(reset_event);
+        machine.dispatch(run_event);
+    }
+    assert(allocation_count == before);
+    printf("Dispatch made no allocations\n");
+
+    // Handler storage stays put when the owner moves
+    esm::state_machine moved(std::move(machine));
+    assert(!machine && moved);
+    length = 0;
+    moved.dispatch(reset_event);
+    moved.dispatch(run_event);
+    assert(moved.current_state() == STATE_RUN && length == 3);
+    esm::state_machine assigned(STATE_ERROR);
+    assigned = std::move(moved);
+    assert(!moved && assigned.current_state() == STATE_RUN);
+    printf("Handlers survived move construction and assignment\n");
+
+    // Replacing a handler releases the old callable
+    int hits = 0;
+    assigned.on_exit(STATE_RUN, counted_handler(&hits));
+    assert(counted_handler::live == 1);
+    assigned.on_exit(STATE_RUN, counted_handler(&hits));
+    assert(counted_handler::live == 1);
+    assigned.dispatch(reset_event);
+    assert(hits == 1 && assigned.current_state() == STATE_INIT);
+    assigned.add_transition(STATE_RUN, STATE_ERROR, EVENT_ERROR, counted_handler(&hits));
+    assert(counted_handler::live == 2);
+    assigned.add_transition(STATE_RUN, STATE_ERROR, EVENT_ERROR);
+    assert(counted_handler::live == 1);
+    assert(assigned.accepts(EVENT_RUN) && assigned.can_reach(STATE_ERROR));
+    printf("Replaced handlers were destroyed\n");
+
+    // Typical captures are stored in place, oversized ones once at assignment
+    before = allocation_count;
+    int a = 0, b = 0, c = 0;
+    assigned.on_enter(STATE_ERROR, [&a, &b, &c](const event_t &) { a++; b++; c++; });
+    assert(allocation_count == before);
+    char big[64] = {0};
+    assigned.on_enter(STATE_ERROR, [big, &a](const event_t &) { a += big[0] + 1; });
+    assert(allocation_count == before + 1);
+    assigned.dispatch(run_event);
+    assigned.dispatch(error_event);
+    assert(assigned.current_state() == STATE_ERROR && a == 1);
+    printf("Small captures stored in place, large capture allocated once\n");
+
+    {
+        esm::state_machine scoped(STATE_INIT);
+        scoped.on_enter(STATE_RUN, counted_handler(&hits));
+        assert(counted_handler::live == 2);
+    }
+    assert(counted_handler::live == 1);
+    printf("Destruction released all handlers\n");
+
+    printf("\nC++ wrapper test completed successfully\n\n");
+}
+
+static void count_action(const event_t *event, void *context) {
+    (void)event;
+    (*(unsigned long *)context)++;
+}
+
+// One round, in nanoseconds per event
+template <typename Dispatch>
+static double time_dispatch(Dispatch dispatch, const event_t *events) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < CPP_PERF_NUM_ITERATIONS; i++) {
+        dispatch(events[i % CPP_PERF_NUM_TRANSITIONS]);
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / CPP_PERF_NUM_ITERATIONS;
+}
+
+void wrapper_performance_test(void) {
+    printf("\nC++ Wrapper Performance Test:\n");
+    printf("=============================\n\n");
+
+    event_t events[CPP_PERF_NUM_TRANSITIONS];
+    for (int i = 0; i < CPP_PERF_NUM_TRANSITIONS; i++) {
+        events[i].event_id = i;
+        events[i].event_data_length = 0;
+        events[i].event_data = NULL;
+    }
+
+    // Same circular machine and handlers on both paths
+    unsigned long c_count = 0;
+    state_machine_t *c_machine = state_machine_create(0);
+    state_machine_set_context(c_machine, &c_count);
+    for (int i = 0; i < CPP_PERF_NUM_TRANSITIONS; i++) {
+        state_machine_add_transition_action(c_machine, i, (i + 1) % CPP_PERF_NUM_TRANSITIONS, i, count_action, NULL);
+        state_machine_assign_on_enter_action(c_machine, i, count_action);
+        state_machine_assign_on_exit_action(c_machine, i, count_action);
+    }
+
+    unsigned long cpp_count = 0;
+    esm::state_machine machine(0);
+    for (int i = 0; i < CPP_PERF_NUM_TRANSITIONS; i++) {
+        machine.add_transition(i, (i + 1) % CPP_PERF_NUM_TRANSITIONS, i, [&cpp_count](const event_t &) { cpp_count++; });
+        machine.on_enter(i, [&cpp_count](const event_t &) { cpp_count++; });
+        machine.on_exit(i, [&cpp_count](const event_t &) { cpp_count++; });
+    }
+
+    long before = allocation_count;
+    // Rounds alternate between the two paths, the best of each is kept
+    double c_ns = 0;
+    double cpp_ns = 0;
+    for (int round = 0; round < CPP_PERF_NUM_ROUNDS; round++) {
+        double c_round = time_dispatch([c_machine](const event_t &event) { state_machine_dispatch(c_machine, &event); }, events);
+        double cpp_round = time_dispatch([&machine](const event_t &event) { machine.dispatch(event); }, events);
+        if (round == 0 || c_round < c_ns) {
+            c_ns = c_round;
+        }
+        if (round == 0 || cpp_round < cpp_ns) {
+            cpp_ns = cpp_round;
+        }
+    }
+    assert(allocation_count == before);
+    assert(c_count == cpp_count && c_count == 3UL * CPP_PERF_NUM_ROUNDS * CPP_PERF_NUM_ITERATIONS);
+
+    printf("Running %d rounds of %d events, three handlers per transition:\n",
+           CPP_PERF_NUM_ROUNDS, CPP_PERF_NUM_ITERATIONS);
+    printf("  C function pointers:  %.2f ns/event\n", c_ns);
+    printf("  C++ wrapper lambdas:  %.2f ns/event\n", cpp_ns);
+    printf("  Wrapper overhead:     %.2f ns/event\n", cpp_ns - c_ns);
+    printf("  Allocations while dispatching: %ld\n", allocation_count - before);
+
+    state_machine_destroy(c_machine);
+}
+
+int main(void) {
+    wrapper_test();
+    wrapper_performance_test();
+    return 0;
+}